@@ -0,0 +1,278 @@
+/*! @file
+    Standalone benchmark of the conformal algorithms, without R.
+
+    It sweeps every combination of the given values of n, p, d, grid side, number of threads, schedule and model,
+    and writes a CSV line with the timings of each combination (and the diagnostics of its last run), e.g.:
+
+        cppconformal_benchmark --n 100,1000 --p 2,10 --d 1,2 --grid-side 20,50 --threads 1,4 \
+            --schedules static,dynamic --models linear,ridge --repetitions 5 --output timings.csv
+*/
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "../src/algorithms/single_grid.hpp"
+#include "../src/algorithms/split.hpp"
+#include "../src/models/kernel_ridge.hpp"
+#include "../src/models/linear_regr.hpp"
+
+/*! Parameters of the sweep (every combination is run).
+*/
+struct BenchmarkOptions {
+    std::vector<int> n = {100, 1000};
+    std::vector<int> p = {2, 10};
+    std::vector<int> d = {1, 2};
+    std::vector<int> grid_side = {20, 50};
+    std::vector<int> threads = {1, omp_get_max_threads()};
+    std::vector<std::string> schedules = {"static"};
+    int schedule_chunk_size = 0;
+    std::vector<std::string> models = {"linear", "ridge"};
+    std::vector<std::string> algorithms = {"single_grid"};
+    int n0 = 1;
+    int repetitions = 3;
+    double lambda = 1.0;
+    int landmarks = 100;
+    std::string precision = "double";
+    double grid_param = 1.25;
+    double train_fraction = 0.5;
+    unsigned seed = 42;
+    std::string output;
+};
+
+/*! Timings of a combination of parameters, in seconds, with the diagnostics of the last run.
+*/
+struct BenchmarkTimings {
+    double min;
+    double median;
+    double max;
+    RunDiagnostics diagnostics;
+};
+
+static std::vector<std::string> split_list(const std::string & value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    if (items.empty()) {
+        throw std::invalid_argument("Empty list: " + value);
+    }
+    return items;
+}
+
+static std::vector<int> split_int_list(const std::string & value) {
+    std::vector<int> items;
+    for (const std::string & item : split_list(value)) {
+        items.push_back(std::stoi(item));
+    }
+    return items;
+}
+
+static void print_usage(std::ostream & stream) {
+    stream << "Usage: cppconformal_benchmark [options]\n"
+           << "Lists are comma-separated; every combination of their values is run.\n"
+           << "  --n LIST             number of observations\n"
+           << "  --p LIST             number of independent variables\n"
+           << "  --d LIST             dimension of the response\n"
+           << "  --grid-side LIST     number of grid points for each side\n"
+           << "  --threads LIST       number of OpenMP threads\n"
+           << "  --schedules LIST     schedules of the parallel loops (static, dynamic, guided)\n"
+           << "  --schedule-chunk-size VALUE  chunk size of the schedules (0: OpenMP default)\n"
+           << "  --models LIST        models (linear, ridge, kernel: Gaussian kernel ridge with gamma = 1/p)\n"
+           << "  --algorithms LIST    algorithms (single_grid, split, sobol, halton: single grid on as many\n"
+           << "                       points of a low-discrepancy sequence as the grid)\n"
+           << "  --n0 VALUE           number of Xhat points\n"
+           << "  --repetitions VALUE  number of timed runs for each combination\n"
+           << "  --lambda VALUE       penalty of the ridge regression\n"
+           << "  --landmarks VALUE    number of landmarks of the kernel model\n"
+           << "  --precision VALUE    precision of the scores of the grid points (double, mixed)\n"
+           << "  --seed VALUE         seed of the generated data\n"
+           << "  --output FILE        CSV output file (default: standard output)\n";
+}
+
+static BenchmarkOptions parse_options(int argc, char ** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string name = argv[i];
+        if (name == "--help") {
+            print_usage(std::cout);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for option " + name);
+        }
+        const std::string value = argv[++i];
+
+        if (name == "--n") options.n = split_int_list(value);
+        else if (name == "--p") options.p = split_int_list(value);
+        else if (name == "--d") options.d = split_int_list(value);
+        else if (name == "--grid-side") options.grid_side = split_int_list(value);
+        else if (name == "--threads") options.threads = split_int_list(value);
+        else if (name == "--schedules") options.schedules = split_list(value);
+        else if (name == "--schedule-chunk-size") options.schedule_chunk_size = std::stoi(value);
+        else if (name == "--models") options.models = split_list(value);
+        else if (name == "--algorithms") options.algorithms = split_list(value);
+        else if (name == "--n0") options.n0 = std::stoi(value);
+        else if (name == "--repetitions") options.repetitions = std::stoi(value);
+        else if (name == "--lambda") options.lambda = std::stod(value);
+        else if (name == "--landmarks") options.landmarks = std::stoi(value);
+        else if (name == "--precision") options.precision = value;
+        else if (name == "--seed") options.seed = std::stoul(value);
+        else if (name == "--output") options.output = value;
+        else throw std::invalid_argument("Unknown option " + name);
+    }
+    if (options.repetitions < 1) {
+        throw std::invalid_argument("repetitions must be at least 1");
+    }
+    return options;
+}
+
+/*! Generate a linear model with gaussian noise, as in examples/rnorm.R.
+*/
+static void generate_data(
+    int n, int p, int d, int n0, unsigned seed,
+    MatrixXd & X, MatrixXd & Y, MatrixXd & Xhat
+) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> covariate(0, 10), noise(0, 0.5);
+    auto sample = [&generator](std::normal_distribution<double> & distribution) { return distribution(generator); };
+
+    X = MatrixXd::NullaryExpr(n, p, [&]() { return sample(covariate); });
+    Xhat = MatrixXd::NullaryExpr(n0, p, [&]() { return sample(covariate); });
+    const MatrixXd beta = MatrixXd::NullaryExpr(p, d, [&]() { return sample(noise); });
+    Y = X * beta + MatrixXd::NullaryExpr(n, d, [&]() { return sample(noise); });
+}
+
+template<class Model>
+static double run_once(
+    const std::string & algorithm, const Model & model, const BenchmarkOptions & options, int grid_side,
+    const ParallelOptions & parallel,
+    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat, RunDiagnostics & diagnostics
+) {
+    const auto start = std::chrono::steady_clock::now();
+    if (algorithm == "single_grid") {
+        SingleGridAlgorithm<Model> single_grid(grid_side, options.grid_param);
+        single_grid.set_parallel_options(parallel);
+        single_grid.set_precision(parse_precision(options.precision));
+        single_grid.run(model, X, Y, Xhat);
+        diagnostics = single_grid.get_diagnostics();
+    } else if (algorithm == "split") {
+        SplitConformalAlgorithm<Model> split(grid_side, options.grid_param, options.train_fraction, options.seed);
+        split.set_parallel_options(parallel);
+        split.run(model, X, Y, Xhat);
+        diagnostics = split.get_diagnostics();
+    } else if (algorithm == "sobol" || algorithm == "halton") {
+        // As many points as the grid, from a low-discrepancy sequence
+        SingleGridAlgorithm<Model> single_grid(grid_side, options.grid_param);
+        single_grid.set_parallel_options(parallel);
+        single_grid.set_precision(parse_precision(options.precision));
+        const PointIndex size = Grid(VectorXd::Zero(Y.cols()), VectorXd::Ones(Y.cols()), grid_side).get_size();
+        if (algorithm == "sobol") {
+            single_grid.template run_on_points<SobolSet>(model, X, Y, Xhat, size);
+        } else {
+            single_grid.template run_on_points<HaltonSet>(model, X, Y, Xhat, size);
+        }
+        diagnostics = single_grid.get_diagnostics();
+    } else {
+        throw std::invalid_argument("Unknown algorithm " + algorithm + " (must be single_grid, split, sobol or halton)");
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Model>
+static BenchmarkTimings time_runs(
+    const std::string & algorithm, const Model & model, const BenchmarkOptions & options, int grid_side,
+    const ParallelOptions & parallel,
+    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+) {
+    // The first run is not timed: it warms up the caches and the OpenMP thread pool
+    RunDiagnostics diagnostics;
+    run_once(algorithm, model, options, grid_side, parallel, X, Y, Xhat, diagnostics);
+
+    std::vector<double> seconds;
+    for (int r = 0; r < options.repetitions; r++) {
+        seconds.push_back(run_once(algorithm, model, options, grid_side, parallel, X, Y, Xhat, diagnostics));
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return {seconds.front(), seconds[seconds.size() / 2], seconds.back(), diagnostics};
+}
+
+static BenchmarkTimings time_model(
+    const std::string & model, const std::string & algorithm, const BenchmarkOptions & options, int grid_side,
+    const ParallelOptions & parallel,
+    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+) {
+    if (model == "linear") {
+        return time_runs(algorithm, LinearRegression(), options, grid_side, parallel, X, Y, Xhat);
+    }
+    if (model == "ridge") {
+        return time_runs(algorithm, RidgeRegression(options.lambda), options, grid_side, parallel, X, Y, Xhat);
+    }
+    if (model == "kernel") {
+        const GaussianKernelRidge kernel_model(GaussianKernel(1.0 / X.cols()), options.lambda, options.landmarks, options.seed);
+        return time_runs(algorithm, kernel_model, options, grid_side, parallel, X, Y, Xhat);
+    }
+    throw std::invalid_argument("Unknown model " + model + " (must be linear, ridge or kernel)");
+}
+
+int main(int argc, char ** argv) {
+    try {
+        const BenchmarkOptions options = parse_options(argc, argv);
+
+        std::ofstream file;
+        if (!options.output.empty()) {
+            file.open(options.output);
+            if (!file) {
+                throw std::runtime_error("Cannot open " + options.output);
+            }
+        }
+        std::ostream & out = options.output.empty() ? std::cout : file;
+
+        out << "algorithm,model,n,p,d,n0,grid_side,grid_points,threads,schedule,schedule_chunk_size,precision,repetitions,"
+            << "min_seconds,median_seconds,max_seconds,points_per_second,"
+            << "setup_seconds,evaluation_seconds,model_fits,load_imbalance\n";
+
+        MatrixXd X, Y, Xhat;
+        for (int n : options.n)
+        for (int p : options.p)
+        for (int d : options.d) {
+            generate_data(n, p, d, options.n0, options.seed, X, Y, Xhat);
+            for (int grid_side : options.grid_side)
+            for (int threads : options.threads)
+            for (const std::string & schedule : options.schedules)
+            for (const std::string & model : options.models)
+            for (const std::string & algorithm : options.algorithms) {
+                ParallelOptions parallel;
+                parallel.num_threads = threads;
+                parallel.schedule = parse_schedule(schedule);
+                parallel.chunk_size = options.schedule_chunk_size;
+                const PointIndex grid_points = Grid(VectorXd::Zero(d), VectorXd::Ones(d), grid_side).get_size();
+                const BenchmarkTimings timings = time_model(model, algorithm, options, grid_side, parallel, X, Y, Xhat);
+
+                out << algorithm << ',' << model << ',' << n << ',' << p << ',' << d << ',' << options.n0 << ','
+                    << grid_side << ',' << grid_points << ',' << threads << ','
+                    << schedule << ',' << options.schedule_chunk_size << ',' << options.precision << ',' << options.repetitions << ','
+                    << timings.min << ',' << timings.median << ',' << timings.max << ','
+                    << options.n0 * grid_points / timings.median << ','
+                    << timings.diagnostics.setup_seconds << ',' << timings.diagnostics.evaluation_seconds << ','
+                    << timings.diagnostics.model_fits << ',' << timings.diagnostics.get_load_imbalance() << '\n';
+                out.flush();
+            }
+        }
+    } catch (const std::exception & e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(std::cerr);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+/*! @file */
+#ifndef __ALGORITHMS__ADAPTIVE_GRID_HPP
+#define __ALGORITHMS__ADAPTIVE_GRID_HPP
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "../grid.hpp"
+#include "../point_set.hpp"
+#include "single_grid.hpp"
+
+/*! Result of a run of @ref AdaptiveGridAlgorithm::run.
+*/
+struct AdaptiveGridResult {
+    //! Coordinates of the corners of the cells of the last refinement
+    MatrixXd y_grid;
+    //! p-values corresponding to those points
+    RowVectorXd p_values;
+    //! Coordinates of the lower corner of each cell of the last refinement
+    MatrixXd cells;
+    //! Length of the cells sides (one for each direction)
+    VectorXd cell_size;
+    //! Initial grid
+    Grid initial_grid;
+};
+
+/*! Implementation of a conformal algorithm with sparse adaptive grid refinement.
+*   The initial grid is divided in cells; at each refinement, only the cells with at least one corner
+*   with p-value greater or equal than the level are kept, and each of them is split in \f$ 2^d \f$ subcells
+*   (as in a \f$ 2^d \f$-tree). Only the corners of the kept cells are evaluated, so that elongated or
+*   non-convex regions do not require a dense grid over their bounding box.
+*
+*   The cells of the i-th refinement lie on a lattice with \f$ (s_0 - 1) 2^i + 1 \f$ points per side
+*   (where \f$ s_0 \f$ is the initial grid side), and they are stored as the lattice index of their lower corner.
+*/
+template<class Model>
+class AdaptiveGridAlgorithm : public AlgorithmBase<Model, AdaptiveGridResult> {
+    public:
+    /*! Construct an AdaptiveGridAlgorithm instance
+        \param grid_levels minimum value of p-values to use at each grid refinement
+        \param initial_grid_side number of points for each side of the initial grid
+        \param initial_grid_param determines the initial size of the grid
+        \param inner_algorithm inner algorithm to use (std::unique_ptr)
+        \param print_progress print to stdout every run of the inner algorithm.
+    */
+    AdaptiveGridAlgorithm(
+        const VectorXd & _grid_levels, int _initial_grid_side,
+        double _initial_grid_param,
+        std::unique_ptr<SingleGridAlgorithm<Model>> _inner_algorithm,
+        bool _print_progress = false
+    ) :
+        grid_levels(_grid_levels), initial_grid_side(_initial_grid_side),
+        initial_grid_param(_initial_grid_param),
+        print_progress(_print_progress),
+        inner_algorithm(std::move(_inner_algorithm))
+    {};
+
+    /*! Run a conformal algorithm with adaptive grid refinement,
+        computing a confidence region for the covariates corresponding to `Xhat`.
+
+        __Remark__: adaptive_grid accepts only a single `Xhat`.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a single point containing the values for the independent variables
+        \return The corners of the cells of the last refinement, with their p-values, and the cells
+    */
+    AdaptiveGridResult run(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat
+    ) override;
+
+    /*! Set the threading options of the parallel evaluation loops, which are run by the inner algorithm.
+    */
+    void set_parallel_options(const ParallelOptions & options) override {
+        AlgorithmBase<Model, AdaptiveGridResult>::set_parallel_options(options);
+        inner_algorithm->set_parallel_options(options);
+    };
+
+    /*! Set the precision of the scores of the evaluation loops, which are run by the inner algorithm.
+    */
+    void set_precision(Precision precision) override {
+        AlgorithmBase<Model, AdaptiveGridResult>::set_precision(precision);
+        inner_algorithm->set_precision(precision);
+    };
+
+    /*! Set the progress monitor of the evaluation loops, which are run by the inner algorithm.
+    */
+    void set_progress_monitor(ProgressMonitor * monitor) override {
+        AlgorithmBase<Model, AdaptiveGridResult>::set_progress_monitor(monitor);
+        inner_algorithm->set_progress_monitor(monitor);
+    };
+
+    private:
+    /*! Compute the strides of a lattice with `side` points per side, checking that its indices fit in 64 bits.
+    */
+    static std::vector<PointIndex> compute_strides(PointIndex side, int d);
+
+    /*! Get the p-value of a lattice point, among the (sorted) evaluated ones.
+    */
+    static double find_p_value(
+        const std::vector<PointIndex> & point_indices, const std::vector<double> & point_p_values,
+        PointIndex point_idx
+    );
+
+    VectorXd grid_levels;
+    int initial_grid_side;
+    double initial_grid_param;
+    bool print_progress;
+    std::unique_ptr<SingleGridAlgorithm<Model>> inner_algorithm;
+};
+
+
+template<class Model>
+std::vector<PointIndex> AdaptiveGridAlgorithm<Model>::compute_strides(PointIndex side, int d) {
+    if (d * std::log2(double(side)) >= 62) {
+        throw std::invalid_argument("The refined lattice is too large (grid side = " + std::to_string(side) +
+            ", d = " + std::to_string(d) + ")");
+    }
+
+    std::vector<PointIndex> strides(d);
+    PointIndex stride = 1;
+    for (int k = 0; k < d; k++) {
+        strides[k] = stride;
+        stride *= side;
+    }
+    return strides;
+}
+
+
+template<class Model>
+double AdaptiveGridAlgorithm<Model>::find_p_value(
+    const std::vector<PointIndex> & point_indices, const std::vector<double> & point_p_values,
+    PointIndex point_idx
+) {
+    auto it = std::lower_bound(point_indices.begin(), point_indices.end(), point_idx);
+    return point_p_values[it - point_indices.begin()];
+}
+
+
+template<class Model>
+AdaptiveGridResult AdaptiveGridAlgorithm<Model>::run(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat
+) {
+    if (Xhat.rows() > 1) {
+        throw std::invalid_argument("You must pass a single Xhat point to adaptive_grid functions");
+    }
+    if (initial_grid_side < 2) {
+        throw std::invalid_argument("initial_grid_side must be at least 2");
+    }
+    this->reset_diagnostics();
+    inner_algorithm->reset_diagnostics();
+    double start_time = omp_get_wtime();
+
+    const int d = Y.cols(), corners_per_cell = 1 << d;
+    const VectorXd initial_ylim = initial_grid_param * Y.array().abs().colwise().maxCoeff();
+    const Grid initial_grid(-initial_ylim, initial_ylim, initial_grid_side);
+    const ArrayXd start = initial_grid.get_start_point();
+
+    // Level 0: every cell of the initial grid is kept, and every grid point is evaluated
+    PointIndex side = initial_grid_side;
+    std::vector<PointIndex> strides = compute_strides(side, d);
+    std::vector<PointIndex> cells, point_indices(initial_grid.get_size());
+    std::vector<double> point_p_values(initial_grid.get_size());
+    std::vector<PointIndex> coords(d), offsets(d);
+
+    if (print_progress) {
+        std::cout << "Running conformal on adaptive grid level 0 (grid_side = " << side <<
+            ", points = " << initial_grid.get_size() << ")" << std::endl;
+    }
+    const RowVectorXd initial_p_values = inner_algorithm->run_on_grid(model, X, Y, Xhat, initial_grid);
+    for (PointIndex i = 0; i < initial_grid.get_size(); i++) {
+        point_indices[i] = i;
+        point_p_values[i] = initial_p_values(i);
+
+        bool is_lower_corner = true;
+        for (int k = 0; k < d; k++) {
+            is_lower_corner &= (i / strides[k]) % side < side - 1;
+        }
+        if (is_lower_corner) {
+            cells.push_back(i);
+        }
+    }
+    this->diagnostics.refinement_seconds.push_back(omp_get_wtime() - start_time);
+
+    for (int level = 0; level < grid_levels.size(); level++) {
+        start_time = omp_get_wtime();
+        const PointIndex new_side = 2 * (side - 1) + 1;
+        const std::vector<PointIndex> new_strides = compute_strides(new_side, d);
+        std::vector<PointIndex> new_cells, new_point_indices;
+
+        for (PointIndex cell : cells) {
+            bool is_selected = false;
+            for (int corner = 0; corner < corners_per_cell && !is_selected; corner++) {
+                PointIndex corner_idx = cell;
+                for (int k = 0; k < d; k++) {
+                    corner_idx += ((corner >> k) & 1) * strides[k];
+                }
+                is_selected = find_p_value(point_indices, point_p_values, corner_idx) >= grid_levels[level];
+            }
+            if (!is_selected) {
+                continue;
+            }
+
+            // Split the cell in 2^d subcells, whose corners are the lattice points 2 * coords + {0, 1, 2}^d
+            PointIndex new_cell = 0;
+            for (int k = 0; k < d; k++) {
+                coords[k] = 2 * ((cell / strides[k]) % side);
+                new_cell += coords[k] * new_strides[k];
+                offsets[k] = 0;
+            }
+            for (int corner = 0; corner < corners_per_cell; corner++) {
+                PointIndex subcell_idx = new_cell;
+                for (int k = 0; k < d; k++) {
+                    subcell_idx += ((corner >> k) & 1) * new_strides[k];
+                }
+                new_cells.push_back(subcell_idx);
+            }
+            while (true) {
+                new_point_indices.push_back(new_cell);
+                int k = 0;
+                while (k < d && offsets[k] == 2) {
+                    new_cell -= 2 * new_strides[k];
+                    offsets[k++] = 0;
+                }
+                if (k == d) {
+                    break;
+                }
+                offsets[k]++;
+                new_cell += new_strides[k];
+            }
+        }
+
+        if (new_cells.empty()) {
+            throw std::runtime_error("No point over min_value = " + std::to_string(grid_levels[level]) + " found");
+        }
+
+        std::sort(new_point_indices.begin(), new_point_indices.end());
+        new_point_indices.erase(std::unique(new_point_indices.begin(), new_point_indices.end()), new_point_indices.end());
+
+        // Points with even coordinates were already evaluated on the previous lattice
+        const ArrayXd new_step = (initial_grid.get_end_point() - initial_grid.get_start_point()).array() / (new_side - 1);
+        std::vector<double> new_point_p_values(new_point_indices.size());
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < new_point_indices.size(); i++) {
+            PointIndex old_idx = 0;
+            bool is_old = true;
+            for (int k = 0; k < d; k++) {
+                const PointIndex coord = (new_point_indices[i] / new_strides[k]) % new_side;
+                is_old &= coord % 2 == 0;
+                old_idx += (coord / 2) * strides[k];
+            }
+            if (is_old) {
+                new_point_p_values[i] = find_p_value(point_indices, point_p_values, old_idx);
+            } else {
+                missing.push_back(i);
+            }
+        }
+
+        MatrixXd missing_points(missing.size(), d);
+        for (size_t i = 0; i < missing.size(); i++) {
+            for (int k = 0; k < d; k++) {
+                missing_points(i, k) = start(k) + ((new_point_indices[missing[i]] / new_strides[k]) % new_side) * new_step(k);
+            }
+        }
+
+        if (print_progress) {
+            std::cout << "Running conformal on adaptive grid level " << level + 1 <<
+                " (grid_side = " << new_side <<
+                ", cells = " << new_cells.size() <<
+                ", new points = " << missing.size() << ")" << std::endl;
+        }
+        const RowVectorXd missing_p_values = inner_algorithm->run_on_grid(model, X, Y, Xhat, PointList(missing_points));
+        for (size_t i = 0; i < missing.size(); i++) {
+            new_point_p_values[missing[i]] = missing_p_values(i);
+        }
+
+        side = new_side;
+        strides = new_strides;
+        cells = std::move(new_cells);
+        point_indices = std::move(new_point_indices);
+        point_p_values = std::move(new_point_p_values);
+        this->diagnostics.refinement_seconds.push_back(omp_get_wtime() - start_time);
+    }
+
+    // The timings and counters of the evaluations are collected by the inner algorithm
+    this->diagnostics.merge(inner_algorithm->get_diagnostics());
+
+    const ArrayXd step = (initial_grid.get_end_point() - initial_grid.get_start_point()).array() / (side - 1);
+    MatrixXd y_grid(point_indices.size(), d), cell_corners(cells.size(), d);
+    for (size_t i = 0; i < point_indices.size(); i++) {
+        for (int k = 0; k < d; k++) {
+            y_grid(i, k) = start(k) + ((point_indices[i] / strides[k]) % side) * step(k);
+        }
+    }
+    for (size_t i = 0; i < cells.size(); i++) {
+        for (int k = 0; k < d; k++) {
+            cell_corners(i, k) = start(k) + ((cells[i] / strides[k]) % side) * step(k);
+        }
+    }
+
+    const RowVectorXd p_values = Map<RowVectorXd>(point_p_values.data(), point_p_values.size());
+    return {y_grid, p_values, cell_corners, step.matrix(), initial_grid};
+}
+
+#endif
@@ -1,30 +1,93 @@
 /*! @file */
 #ifndef __ALGORITHMS__BASE_HPP
 #define __ALGORITHMS__BASE_HPP
-#include <iostream>
-#include <RcppEigen.h>
+#include <Eigen/Dense>
+#include "../data_view.hpp"
 #include "../grid.hpp"
+#include "diagnostics.hpp"
+#include "parallel.hpp"
+#include "progress.hpp"
+#include "residual_engines.hpp"
 
-/*! Abstract class for a conformal algorithm
+/*! Abstract class for a conformal algorithm.
+    The algorithms depend only on Eigen and OpenMP: they report errors with standard exceptions,
+    and their results are converted to R objects in exports.cpp.
     \param Model class model base
+    \param Result type of the result of a run
 */
-template<class Model>
+template<class Model, class Result>
 class AlgorithmBase {
     public:
+    virtual ~AlgorithmBase() {};
+
     /*! Run a conformal regression algorithm.
 
-        __Remark__: multi_grid accepts only a single `Xhat`.
+        __Remark__: adaptive_grid accepts only a single `Xhat`.
 
         \param model model to use as a base for conformal regression (will be copied at each run)
         \param X matrix of the independent variables
         \param Y matrix of the covariates
-        \param Xhat a single point containing the values for the independent variables
-        \return An Rcpp list
+        \param Xhat a matrix containing one or more points to use as values for the independent variables
+        \return The result of the algorithm
     */
-    virtual List run(
+    virtual Result run(
         const Model & model,
-        const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat
     ) = 0;
+
+    /*! Set the threading options of the parallel evaluation loops (see @ref ParallelOptions).
+    */
+    virtual void set_parallel_options(const ParallelOptions & options) {
+        parallel_options = options;
+    };
+
+    /*! Set the precision of the nonconformity scores of the evaluation loops (see @ref Precision).
+    */
+    virtual void set_precision(Precision _precision) {
+        precision = _precision;
+    };
+
+    /*! Get the precision of the nonconformity scores of the evaluation loops (see @ref Precision).
+    */
+    Precision get_precision() const {
+        return precision;
+    };
+
+    /*! Set the monitor receiving the progress of the evaluation loops, which can cancel them (see @ref ProgressMonitor).
+        \param monitor monitor (must outlive the runs; null to disable monitoring)
+    */
+    virtual void set_progress_monitor(ProgressMonitor * monitor) {
+        progress_monitor = monitor;
+    };
+
+    /*! Get the phase timings and counters of the last run (see @ref RunDiagnostics).
+    */
+    const RunDiagnostics & get_diagnostics() const {
+        return diagnostics;
+    };
+
+    /*! Clear the diagnostics: they are otherwise accumulated over the calls, e.g. when used as an inner algorithm.
+    */
+    void reset_diagnostics() {
+        diagnostics = RunDiagnostics();
+    };
+
+    protected:
+    /*! Record the threading options in the diagnostics, before entering a parallel loop
+        (the options are applied by a @ref ParallelScope).
+        \return The number of threads of the loop
+    */
+    int prepare_parallel_loop() {
+        diagnostics.schedule = get_schedule_name(parallel_options.schedule);
+        diagnostics.schedule_chunk_size = parallel_options.chunk_size;
+        diagnostics.prepare_threads(parallel_options.get_num_threads());
+        return parallel_options.get_num_threads();
+    };
+
+    ParallelOptions parallel_options;
+    Precision precision = Precision::Double;
+    ProgressMonitor * progress_monitor = nullptr;
+    RunDiagnostics diagnostics;
 };
 
 #endif
@@ -0,0 +1,96 @@
+/*! @file */
+#ifndef __ALGORITHMS__DIAGNOSTICS_HPP
+#define __ALGORITHMS__DIAGNOSTICS_HPP
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "../point_set.hpp"
+
+/*! Phase timings and counters collected during a run of an algorithm.
+    The overhead is a few clock reads for each phase and for each thread of a parallel loop:
+    nothing is recorded for the single grid points.
+    All the times are wall times in seconds, and are summed over the calls of the same phase (e.g. over chunks).
+*/
+struct RunDiagnostics {
+    //! Time spent before the evaluation loops (checks, fitting or factorising the model on the training data)
+    double setup_seconds = 0;
+    //! Time spent in the parallel evaluation loops
+    double evaluation_seconds = 0;
+    //! Time spent at each refinement level of multi-grid and adaptive algorithms (including the evaluation)
+    std::vector<double> refinement_seconds;
+    //! Time spent converting the result (set by the caller)
+    double marshalling_seconds = 0;
+    //! Number of (`Xhat`, grid point) pairs evaluated
+    PointIndex points_evaluated = 0;
+    //! Number of (`Xhat`, grid point) pairs of a membership evaluation decided by the bounds of the scores over their block,
+    //! without computing their scores (included in `points_evaluated`)
+    PointIndex points_bounded = 0;
+    //! Number of scores computed again in double precision, being too close to the one of the tested point
+    //! to be compared in single precision (see @ref Precision::Mixed)
+    long long scores_rechecked = 0;
+    //! Number of model fits, including the rank-one updates and the updates of the factorisation for each `Xhat`
+    long long model_fits = 0;
+    //! Maximum number of threads used by a parallel loop
+    int threads = 0;
+    //! Schedule of the parallel loops (see @ref ParallelOptions)
+    std::string schedule;
+    //! Chunk size of the schedule of the parallel loops (0: the OpenMP default)
+    int schedule_chunk_size = 0;
+    //! Time spent by each thread in the parallel loops
+    std::vector<double> thread_seconds;
+
+    /*! Get the load imbalance of the parallel loops, as the ratio between the maximum and the mean thread time
+        (1 when the work is perfectly balanced).
+    */
+    double get_load_imbalance() const {
+        const double total = std::accumulate(thread_seconds.begin(), thread_seconds.end(), 0.0);
+        if (total <= 0) {
+            return 1;
+        }
+        return *std::max_element(thread_seconds.begin(), thread_seconds.end()) * thread_seconds.size() / total;
+    };
+
+    /*! Make room for the threads of a parallel loop, before entering it.
+        \param num_threads number of threads of the loop
+    */
+    void prepare_threads(int num_threads) {
+        if (int(thread_seconds.size()) < num_threads) {
+            thread_seconds.resize(num_threads, 0.0);
+        }
+    };
+
+    /*! Record the work of the calling thread at the end of a parallel loop (each thread writes only its own entry).
+        \param seconds time spent by the thread in the loop
+    */
+    void add_thread_time(double seconds) {
+        thread_seconds[omp_get_thread_num()] += seconds;
+    };
+
+    /*! Add the diagnostics of another run, e.g. of an inner algorithm.
+    */
+    void merge(const RunDiagnostics & other) {
+        setup_seconds += other.setup_seconds;
+        evaluation_seconds += other.evaluation_seconds;
+        refinement_seconds.insert(refinement_seconds.end(), other.refinement_seconds.begin(), other.refinement_seconds.end());
+        marshalling_seconds += other.marshalling_seconds;
+        points_evaluated += other.points_evaluated;
+        points_bounded += other.points_bounded;
+        scores_rechecked += other.scores_rechecked;
+        model_fits += other.model_fits;
+        threads = std::max(threads, other.threads);
+        if (!other.schedule.empty()) {
+            schedule = other.schedule;
+            schedule_chunk_size = other.schedule_chunk_size;
+        }
+        if (thread_seconds.size() < other.thread_seconds.size()) {
+            thread_seconds.resize(other.thread_seconds.size(), 0.0);
+        }
+        for (size_t i = 0; i < other.thread_seconds.size(); i++) {
+            thread_seconds[i] += other.thread_seconds[i];
+        }
+    };
+};
+
+#endif
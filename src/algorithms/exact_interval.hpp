@@ -0,0 +1,248 @@
+/*! @file */
+#ifndef __ALGORITHMS__EXACT_INTERVAL_HPP
+#define __ALGORITHMS__EXACT_INTERVAL_HPP
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "base.hpp"
+#include "residual_engines.hpp"
+
+/*! Exact conformal region for a single `Xhat`, for a one-dimensional response.
+    The p-value is a step function of y0: it is constant on each open segment between two breakpoints.
+*/
+struct ExactConformalRegion {
+    //! Sorted points where the p-value may change (m)
+    VectorXd breakpoints;
+    //! p-values on the segments (-Inf, b_0), (b_0, b_1), ..., (b_{m-1}, +Inf) (m+1)
+    VectorXd p_values;
+    //! p-values at the breakpoints (m)
+    VectorXd breakpoint_p_values;
+    //! Disjoint intervals (one per row, start and end) where the p-value is greater or equal than alpha
+    MatrixXd intervals;
+};
+
+/*! Implementation of a grid-free conformal algorithm for one-dimensional responses.
+    Each residual is \f$ |a_i + b_i y_0| \f$, so the p-value only changes where
+    \f$ |a_i + b_i y_0| = |a_n + b_n y_0| \f$: the crossing points are sorted and swept,
+    with a cost of \f$ O(n \log n) \f$ for each `Xhat`.
+    The model must provide `compute_affine_residuals` (as linear and ridge regressions do).
+*/
+template<class Model>
+class ExactIntervalAlgorithm : public AlgorithmBase<Model, std::vector<ExactConformalRegion>> {
+    static_assert(has_affine_residuals<Model>::value,
+        "ExactIntervalAlgorithm requires a model providing compute_affine_residuals");
+
+    public:
+    /*! Construct an ExactIntervalAlgorithm instance
+        \param alpha the returned intervals contain the points with p-value greater or equal than alpha
+    */
+    ExactIntervalAlgorithm(double _alpha) : alpha(_alpha) {};
+
+    /*! Compute the exact conformal region from the affine residuals of a single `Xhat`.
+        \param intercept intercepts of the residuals ((n+1) x 1)
+        \param slope slopes of the residuals (n+1)
+        \param tie_breaking weight given to ties between residuals
+        \return The conformal region
+    */
+    ExactConformalRegion compute_region(
+        const MatrixXd & intercept, const VectorXd & slope, double tie_breaking
+    ) const;
+
+    /*! Run the exact conformal algorithm, computing a prediction interval for each row of `Xhat`.
+
+        \param model model to use for conformal regression
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates (with a single column)
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \return The conformal region for each `Xhat`
+    */
+    std::vector<ExactConformalRegion> run(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat
+    ) override;
+
+    private:
+    double alpha;
+};
+
+
+template<class Model>
+ExactConformalRegion ExactIntervalAlgorithm<Model>::compute_region(
+    const MatrixXd & intercept, const VectorXd & slope, double tie_breaking
+) const {
+    struct Crossing {
+        double position;
+        int i;
+        int factor;
+    };
+
+    // (a_i + b_i y)^2 - (a_n + b_n y)^2 is the product of the two linear factors
+    // (a_i - a_n) + (b_i - b_n) y and (a_i + a_n) + (b_i + b_n) y:
+    // the i-th residual is greater than the tested one where the signs of the factors agree.
+    const int n = intercept.rows() - 1;
+    const double a_n = intercept(n, 0), b_n = slope(n);
+    std::vector<Crossing> crossings;
+    crossings.reserve(2 * n);
+    std::vector<signed char> signs(2 * (n + 1));
+    int greater = 0, equal = 0;
+
+    for (int i = 0; i <= n; i++) {
+        for (int factor = 0; factor < 2; factor++) {
+            const double sign = factor == 0 ? -1 : 1;
+            const double c = intercept(i, 0) + sign * a_n, m = slope(i) + sign * b_n;
+            if (m != 0) {
+                crossings.push_back({-c / m, i, factor});
+                signs[2 * i + factor] = m > 0 ? -1 : 1;
+            } else {
+                signs[2 * i + factor] = (c > 0) - (c < 0);
+            }
+        }
+        const int value = signs[2 * i] * signs[2 * i + 1];
+        greater += value > 0;
+        equal += value == 0;
+    }
+
+    std::sort(crossings.begin(), crossings.end(), [](const Crossing & a, const Crossing & b) {
+        return a.position < b.position;
+    });
+
+    std::vector<double> breakpoints, p_values, breakpoint_p_values;
+    p_values.push_back((greater + tie_breaking * equal) / (n + 1.0));
+    std::vector<int> last_seen(n + 1, -1), touched;
+
+    for (size_t k = 0; k < crossings.size(); ) {
+        const double position = crossings[k].position;
+        int greater_at = greater, equal_at = equal;
+        touched.clear();
+
+        // At the crossing at least one factor is zero, so each involved residual ties with the tested one
+        for (; k < crossings.size() && crossings[k].position == position; k++) {
+            const int i = crossings[k].i;
+            if (last_seen[i] != int(breakpoints.size())) {
+                last_seen[i] = breakpoints.size();
+                touched.push_back(i);
+                const int value = signs[2 * i] * signs[2 * i + 1];
+                greater_at -= value > 0;
+                equal_at += value != 0;
+                greater -= value > 0;
+                equal -= value == 0;
+            }
+            signs[2 * i + crossings[k].factor] *= -1;
+        }
+        for (int i : touched) {
+            const int value = signs[2 * i] * signs[2 * i + 1];
+            greater += value > 0;
+            equal += value == 0;
+        }
+
+        breakpoints.push_back(position);
+        breakpoint_p_values.push_back((greater_at + tie_breaking * equal_at) / (n + 1.0));
+        p_values.push_back((greater + tie_breaking * equal) / (n + 1.0));
+    }
+
+    // Merge the segments and breakpoints with p-value greater or equal than alpha into intervals
+    std::vector<double> starts, ends;
+    bool is_open = false;
+    auto add_piece = [&](double start, double end, double p_value) {
+        if (p_value >= alpha) {
+            if (!is_open) {
+                starts.push_back(start);
+                ends.push_back(end);
+                is_open = true;
+            } else {
+                ends.back() = end;
+            }
+        } else {
+            is_open = false;
+        }
+    };
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < breakpoints.size(); k++) {
+        add_piece(k == 0 ? -infinity : breakpoints[k - 1], breakpoints[k], p_values[k]);
+        add_piece(breakpoints[k], breakpoints[k], breakpoint_p_values[k]);
+    }
+    add_piece(breakpoints.empty() ? -infinity : breakpoints.back(), infinity, p_values.back());
+
+    ExactConformalRegion region;
+    region.breakpoints = Map<VectorXd>(breakpoints.data(), breakpoints.size());
+    region.p_values = Map<VectorXd>(p_values.data(), p_values.size());
+    region.breakpoint_p_values = Map<VectorXd>(breakpoint_p_values.data(), breakpoint_p_values.size());
+    region.intervals.resize(starts.size(), 2);
+    for (size_t k = 0; k < starts.size(); k++) {
+        region.intervals(k, 0) = starts[k];
+        region.intervals(k, 1) = ends[k];
+    }
+    return region;
+}
+
+
+template<class Model>
+std::vector<ExactConformalRegion> ExactIntervalAlgorithm<Model>::run(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat
+) {
+    if (X.cols() != Xhat.cols()) {
+        throw std::invalid_argument("X.cols() != Xhat.cols(), but they must be equal (to p)");
+    }
+    if (X.rows() != Y.rows()) {
+        throw std::invalid_argument("X.rows() != y.rows(), but they must be equal (to n)");
+    }
+    if (Y.cols() != 1) {
+        throw std::invalid_argument("Exact conformal intervals require a single response (Y.cols() == 1)");
+    }
+
+    this->reset_diagnostics();
+    double start_time = omp_get_wtime();
+    const int n0 = Xhat.rows();
+    const double tie_breaking = draw_tie_breaking();
+    std::vector<ExactConformalRegion> regions(n0);
+    Model base_model(model);
+    AffineResidualEngine<Model>::prepare_model(base_model, X, Y);
+    this->diagnostics.model_fits += AffineResidualEngine<Model>::prepare_fits;
+    if (is_base_singular(base_model, has_base_singularity<Model>())) {
+        throw std::invalid_argument("Exact conformal intervals require a non-singular Gram matrix of X "
+                                    "(no more columns than rows, and no collinear columns), or a ridge penalty");
+    }
+    this->diagnostics.setup_seconds = omp_get_wtime() - start_time;
+
+    start_time = omp_get_wtime();
+    long long fits = 0;
+    const int num_threads = this->prepare_parallel_loop();
+    const ParallelScope scope(this->parallel_options);
+    LoopProgress progress(this->progress_monitor, n0);
+
+    #pragma omp parallel num_threads(num_threads) reduction(+:fits)
+    {
+        const double thread_start_time = omp_get_wtime();
+        AffineResidualEngine<Model> engine(base_model, X, Y);
+
+        // Each row is cheap: the master thread polls the monitor between its own rows
+        #pragma omp for schedule(runtime) nowait
+        for (int i = 0; i < n0; i++) {
+            if (progress.is_cancelled()) {
+                continue;
+            }
+            engine.set_xhat(Xhat.row(i));
+            regions[i] = compute_region(engine.get_intercept(), engine.get_slope(), tie_breaking);
+            progress.add_done(1);
+            progress.poll();
+        }
+
+        fits += engine.get_fit_count();
+        this->diagnostics.add_thread_time(omp_get_wtime() - thread_start_time);
+        #pragma omp master
+        this->diagnostics.threads = std::max(this->diagnostics.threads, omp_get_num_threads());
+    }
+
+    progress.poll(true);
+    progress.check();
+    this->diagnostics.evaluation_seconds = omp_get_wtime() - start_time;
+    this->diagnostics.model_fits += fits;
+    return regions;
+}
+
+#endif
@@ -0,0 +1,281 @@
+/*! @file */
+#ifndef __ALGORITHMS__LEVEL_SETS_HPP
+#define __ALGORITHMS__LEVEL_SETS_HPP
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "../grid.hpp"
+#include "parallel.hpp"
+
+/*! Boundary of the conformal region \f$ \{y : p(y) \geq \alpha\} \f$ of an `Xhat`, estimated from the p-values of a grid.
+    For d = 2 it is described by contour lines, and otherwise by the cells of the grid crossed by the boundary.
+*/
+struct LevelSet {
+    //! Level of the set
+    double alpha;
+    //! Number of grid points with p-value greater or equal than alpha
+    PointIndex count = 0;
+    //! Smallest coordinates of these points along each axis (NaN when there is none)
+    VectorXd start_point;
+    //! Largest coordinates of these points along each axis (NaN when there is none)
+    VectorXd end_point;
+    //! For d = 2, the contour lines (one row for each vertex), interpolated linearly between the grid points
+    std::vector<MatrixXd> contours;
+    //! For d = 2, whether each contour line is closed (its last vertex is the first one); the open ones end on the border of the grid
+    std::vector<bool> closed;
+    //! For d != 2, the indices of the lower corners of the boundary cells, i.e. of the cells of the grid
+    //! having corners both inside and outside of the region
+    std::vector<PointIndex> boundary_cells;
+};
+
+/*! Extraction of the level sets of the p-values computed on a grid, e.g. by @ref SingleGridAlgorithm::run,
+    so that only the boundaries of the conformal regions need to be returned, instead of every grid point.
+    For d = 2, the contour lines are traced with marching squares (the saddle cells are decided by the mean of their corners);
+    for the other dimensions, the boundary cells are listed. The extents of the regions along each axis are computed for every d.
+    The (`Xhat`, alpha) pairs are extracted in parallel.
+*/
+class LevelSetExtractor {
+    public:
+    /*! Construct a LevelSetExtractor instance
+        \param alphas levels of the sets
+    */
+    LevelSetExtractor(const VectorXd & _alphas) : alphas(_alphas) {};
+
+    /*! Set the threading options of the extraction (see @ref ParallelOptions).
+    */
+    void set_parallel_options(const ParallelOptions & options) {
+        parallel_options = options;
+    };
+
+    /*! Extract the level sets of the p-values of each `Xhat`.
+        \param grid grid of the p-values
+        \param p_values p-values (one row for each `Xhat`, one column for each grid point)
+        \return The level sets for each `Xhat` (one for each alpha)
+    */
+    std::vector<std::vector<LevelSet>> extract(const Grid & grid, const MatrixXd & p_values) const;
+
+    /*! Extract a level set of the p-values of an `Xhat`.
+        \param grid grid of the p-values
+        \param p_values p-values of the grid points
+        \param alpha level of the set
+    */
+    static LevelSet extract_level_set(const Grid & grid, const Ref<const RowVectorXd> & p_values, double alpha);
+
+    private:
+    /*! Trace the contour lines of a two-dimensional grid with marching squares.
+        The crossing points are identified by the edge of the grid they lie on (two for each grid point:
+        the one towards the next point along the first axis, and the one along the second axis),
+        so that the segments of neighbouring cells are joined through the edges they share.
+    */
+    static void add_contours(const Grid & grid, const Ref<const RowVectorXd> & p_values, double alpha, LevelSet & level_set);
+
+    /*! List the cells of the grid having corners both inside and outside of the region.
+    */
+    static void add_boundary_cells(const Grid & grid, const std::vector<bool> & inside, LevelSet & level_set);
+
+    VectorXd alphas;
+    ParallelOptions parallel_options;
+};
+
+
+inline std::vector<std::vector<LevelSet>> LevelSetExtractor::extract(const Grid & grid, const MatrixXd & p_values) const {
+    if (p_values.cols() != grid.get_size()) {
+        throw std::invalid_argument("p_values.cols() != grid.get_size(), but they must be equal");
+    }
+    const int n0 = p_values.rows(), n_alphas = alphas.size();
+    std::vector<std::vector<LevelSet>> level_sets(n0, std::vector<LevelSet>(n_alphas));
+
+    const ParallelScope scope(parallel_options);
+    #pragma omp parallel for schedule(runtime) num_threads(parallel_options.get_num_threads())
+    for (int k = 0; k < n0 * n_alphas; k++) {
+        const int i = k / n_alphas, a = k % n_alphas;
+        level_sets[i][a] = extract_level_set(grid, p_values.row(i), alphas(a));
+    }
+    return level_sets;
+}
+
+
+inline LevelSet LevelSetExtractor::extract_level_set(const Grid & grid, const Ref<const RowVectorXd> & p_values, double alpha) {
+    LevelSet level_set;
+    level_set.alpha = alpha;
+    const int d = grid.get_dimension();
+    level_set.start_point = VectorXd::Constant(d, std::numeric_limits<double>::infinity());
+    level_set.end_point = VectorXd::Constant(d, -std::numeric_limits<double>::infinity());
+
+    std::vector<bool> inside(grid.get_size());
+    for (Grid::Iterator it(grid); it.is_valid(); it.next()) {
+        if (p_values(it.get_index()) >= alpha) {
+            inside[it.get_index()] = true;
+            level_set.count++;
+            level_set.start_point = level_set.start_point.cwiseMin(it.get_point());
+            level_set.end_point = level_set.end_point.cwiseMax(it.get_point());
+        }
+    }
+    if (level_set.count == 0) {
+        level_set.start_point.setConstant(std::numeric_limits<double>::quiet_NaN());
+        level_set.end_point.setConstant(std::numeric_limits<double>::quiet_NaN());
+    }
+
+    if (d == 2) {
+        add_contours(grid, p_values, alpha, level_set);
+    } else {
+        add_boundary_cells(grid, inside, level_set);
+    }
+    return level_set;
+}
+
+
+inline void LevelSetExtractor::add_contours(const Grid & grid, const Ref<const RowVectorXd> & p_values, double alpha, LevelSet & level_set) {
+    const int side = grid.get_grid_side();
+    const VectorXd & start = grid.get_start_point();
+    const VectorXd & step = grid.get_step_increment();
+
+    // The edge 2 * index starts from the point index along the first axis, the edge 2 * index + 1 along the second one
+    auto get_crossing = [&](PointIndex edge) {
+        const PointIndex a = edge / 2, b = a + (edge % 2 == 0 ? 1 : side);
+        const double t = (alpha - p_values(a)) / (p_values(b) - p_values(a));
+        const double x = a % side + (edge % 2 == 0 ? t : 0), y = a / side + (edge % 2 == 0 ? 0 : t);
+        return Vector2d(start(0) + x * step(0), start(1) + y * step(1));
+    };
+
+    // Segments between two crossing edges, and the (at most two) segments through each crossing edge
+    std::vector<std::array<PointIndex, 2>> segments;
+    std::unordered_map<PointIndex, std::array<int, 2>> edge_segments;
+    auto add_segment = [&](PointIndex from, PointIndex to) {
+        const int s = segments.size();
+        segments.push_back({from, to});
+        for (PointIndex edge : {from, to}) {
+            auto inserted = edge_segments.insert({edge, {s, -1}});
+            if (!inserted.second) {
+                inserted.first->second[1] = s;
+            }
+        }
+    };
+
+    for (int j = 0; j + 1 < side; j++) {
+        for (int i = 0; i + 1 < side; i++) {
+            // Corners counterclockwise from the lower left one; the edge e joins the corners e and e + 1
+            const PointIndex corner_indices[4] = {i + PointIndex(j) * side, i + 1 + PointIndex(j) * side,
+                                                  i + 1 + PointIndex(j + 1) * side, i + PointIndex(j + 1) * side};
+            const PointIndex edges[4] = {2 * corner_indices[0], 2 * corner_indices[1] + 1,
+                                         2 * corner_indices[3], 2 * corner_indices[0] + 1};
+            bool corners[4];
+            int n_inside = 0;
+            for (int c = 0; c < 4; c++) {
+                corners[c] = p_values(corner_indices[c]) >= alpha;
+                n_inside += corners[c];
+            }
+            if (n_inside == 0 || n_inside == 4) {
+                continue;
+            }
+
+            int crossing[4], n_crossing = 0;
+            for (int e = 0; e < 4; e++) {
+                if (corners[e] != corners[(e + 1) % 4]) {
+                    crossing[n_crossing++] = e;
+                }
+            }
+            if (n_crossing == 2) {
+                add_segment(edges[crossing[0]], edges[crossing[1]]);
+                continue;
+            }
+
+            // Saddle: the segments cut off the corners on the other side of the center of the cell
+            double center = 0;
+            for (int c = 0; c < 4; c++) {
+                center += p_values(corner_indices[c]) / 4;
+            }
+            const bool center_inside = center >= alpha;
+            for (int c = 0; c < 4; c++) {
+                if (corners[c] != center_inside) {
+                    add_segment(edges[(c + 3) % 4], edges[c]);
+                }
+            }
+        }
+    }
+
+    // Join the segments into lines, starting from the open ends (edges with a single segment), and then from the closed loops
+    std::vector<bool> used(segments.size(), false);
+    auto trace = [&](int first_segment, PointIndex first_edge) {
+        std::vector<Vector2d> vertices = {get_crossing(first_edge)};
+        PointIndex edge = first_edge;
+        for (int s = first_segment; s >= 0 && !used[s]; ) {
+            used[s] = true;
+            edge = segments[s][0] == edge ? segments[s][1] : segments[s][0];
+            vertices.push_back(get_crossing(edge));
+            const std::array<int, 2> & next = edge_segments[edge];
+            s = next[0] == s ? next[1] : next[0];
+        }
+        MatrixXd contour(vertices.size(), 2);
+        for (size_t v = 0; v < vertices.size(); v++) {
+            contour.row(v) = vertices[v].transpose();
+        }
+        level_set.contours.push_back(contour);
+        level_set.closed.push_back(edge == first_edge && vertices.size() > 2);
+    };
+    for (size_t s = 0; s < segments.size(); s++) {
+        for (PointIndex edge : segments[s]) {
+            if (!used[s] && edge_segments[edge][1] < 0) {
+                trace(s, edge);
+            }
+        }
+    }
+    for (size_t s = 0; s < segments.size(); s++) {
+        if (!used[s]) {
+            trace(s, segments[s][0]);
+        }
+    }
+}
+
+
+inline void LevelSetExtractor::add_boundary_cells(const Grid & grid, const std::vector<bool> & inside, LevelSet & level_set) {
+    const int d = grid.get_dimension(), side = grid.get_grid_side();
+    if (side < 2) {
+        return;
+    }
+
+    // Offsets of the 2^d corners of a cell from its lower corner
+    std::vector<PointIndex> corner_offsets = {0};
+    PointIndex stride = 1;
+    for (int k = 0; k < d; k++) {
+        const size_t n_offsets = corner_offsets.size();
+        for (size_t c = 0; c < n_offsets; c++) {
+            corner_offsets.push_back(corner_offsets[c] + stride);
+        }
+        stride *= side;
+    }
+
+    // The lower corners are the points whose coordinates are all below the last one, visited as in an odometer
+    std::vector<int> coords(d, 0);
+    PointIndex index = 0;
+    while (true) {
+        const bool first_inside = inside[index];
+        for (size_t c = 1; c < corner_offsets.size(); c++) {
+            if (inside[index + corner_offsets[c]] != first_inside) {
+                level_set.boundary_cells.push_back(index);
+                break;
+            }
+        }
+
+        int k = 0;
+        PointIndex k_stride = 1;
+        while (k < d && coords[k] + 2 >= side) {
+            index -= coords[k] * k_stride;
+            coords[k] = 0;
+            k_stride *= side;
+            k++;
+        }
+        if (k == d) {
+            break;
+        }
+        coords[k]++;
+        index += k_stride;
+    }
+}
+
+#endif
@@ -1,21 +1,57 @@
 /*! @file */
 #ifndef __ALGORITHMS__MULTI_GRID_HPP
 #define __ALGORITHMS__MULTI_GRID_HPP
+#include <algorithm>
 #include <iostream>
-#include <RcppEigen.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
 #include "../grid.hpp"
+#include "../low_discrepancy.hpp"
 #include "single_grid.hpp"
 
+/*! Result of a run of @ref MultiGridAlgorithm::run.
+    \param Points type of the sets of points (@ref Grid, or e.g. @ref SobolSet)
+*/
+template<class Points>
+struct BasicMultiGridResult {
+    //! History of the grids tried for each `Xhat` (the p-values refer to the last one)
+    std::vector<std::vector<Points>> grids;
+    //! p-values on the last grid, for each `Xhat`
+    std::vector<RowVectorXd> p_values;
+};
+
+//! Result of a run of @ref MultiGridAlgorithm::run on grids
+typedef BasicMultiGridResult<Grid> MultiGridResult;
+
+/*! Print the resolution of a grid (its side).
+*/
+inline void print_resolution(std::ostream & out, const Grid & grid) {
+    out << "grid_side = " << grid.get_grid_side();
+}
+
+/*! Print the resolution of a low-discrepancy set (its number of points).
+*/
+template<class Sequence>
+void print_resolution(std::ostream & out, const LowDiscrepancySet<Sequence> & points) {
+    out << Sequence::get_name() << " points = " << points.get_size();
+}
+
 /*! Implementation of a multi-grid conformal algorithm.
 *   It uses an "inner" single-grid algorithm at each step to recursively select a subgrid.
+*   The sets of points are grids by default, but any set of points in a box can be used instead (e.g. @ref SobolSet),
+*   if it can be constructed from the corners of the box and a number of points, and provides `get_step_increment()`.
 */
-template<class Model>
-class MultiGridAlgorithm : public AlgorithmBase<Model> {
+template<class Model, class Points = Grid>
+class MultiGridAlgorithm : public AlgorithmBase<Model, BasicMultiGridResult<Points>> {
     public:
     /*! Construct a MultiGridAlgorithm instance
         \param grid_levels minimum value of p-values to use at each grid refinement
-        \param grid_sides number of points for each side of the grid, for each grid refinement
-            (must be one item longer than grid_levels)
+        \param grid_sides number of points for each side of the grid (for a @ref Grid), or number of points (for other sets),
+            for each grid refinement (must be one item longer than grid_levels)
         \param initial_grid_param determines the initial size of the grid
         \param inner_algorithm inner algorithm to use (std::unique_ptr)
         \param print_progress print to stdout every run of the inner algorithm.
@@ -40,31 +76,63 @@ class MultiGridAlgorithm : public AlgorithmBase<Model> {
         \param new_grid_side number of points for each side of the grid
         \return The new grid object
     */
-    static Grid create_new_grid_from_pvalues(
-        const Grid & old_grid, const RowVectorXd & p_values, double min_value, int new_grid_side
+    static Points create_new_grid_from_pvalues(
+        const Points & old_grid, const RowVectorXd & p_values, double min_value, PointIndex new_grid_side
+    );
+
+    /*! Create a new grid covering the points of a previous grid in the conformal region (and their neighbours).
+        \param old_grid grid used to evaluate the membership
+        \param members points of the old grid in the conformal region
+        \param new_grid_side number of points for each side of the grid (for a @ref Grid), or number of points (for other sets)
+        \return The new grid object
+    */
+    static Points create_new_grid_from_membership(
+        const Points & old_grid, const PointBitset & members, PointIndex new_grid_side
     );
 
     /*! Run a conformal algorithm with multi grid refinement,
         computing a confidence region for the covariates corresponding to `Xhat`.
-
-        __Remark__: multi_grid accepts only a single `Xhat`.
+        Each `Xhat` is refined independently, but at each level the grid points of all of them
+        are evaluated in a single parallel loop. Before the last level, only the membership of the grid points
+        is evaluated (see @ref SingleGridAlgorithm::run_membership_on_grids).
 
         \param model model to use as a base for conformal regression (will be copied at each run)
         \param X matrix of the independent variables
         \param Y matrix of the covariates
-        \param Xhat a single point containing the values for the independent variables
-        \return An Rcpp list with the following members:
-        - `y_grid`: matrix with the coordinates of grid points in the space of the covariates
-        - `p_values`: p-values corresponding to those grid points
-        - `y_grid_parameters`: vector with the history of grid parameters (start point, end point, grid side)
-            for each tried grid
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \return The history of the grids tried for each `Xhat`, and the p-values on the last one
     */
-    List run(
+    BasicMultiGridResult<Points> run(
         const Model & model,
-        const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat
     ) override;
 
+    /*! Set the threading options of the parallel evaluation loops, which are run by the inner algorithm.
+    */
+    void set_parallel_options(const ParallelOptions & options) override {
+        AlgorithmBase<Model, BasicMultiGridResult<Points>>::set_parallel_options(options);
+        inner_algorithm->set_parallel_options(options);
+    };
+
+    /*! Set the precision of the scores of the evaluation loops, which are run by the inner algorithm.
+    */
+    void set_precision(Precision precision) override {
+        AlgorithmBase<Model, BasicMultiGridResult<Points>>::set_precision(precision);
+        inner_algorithm->set_precision(precision);
+    };
+
+    /*! Set the progress monitor of the evaluation loops, which are run by the inner algorithm.
+    */
+    void set_progress_monitor(ProgressMonitor * monitor) override {
+        AlgorithmBase<Model, BasicMultiGridResult<Points>>::set_progress_monitor(monitor);
+        inner_algorithm->set_progress_monitor(monitor);
+    };
+
     private:
+    /*! Print the grids used at a level of refinement.
+    */
+    void print_level(int level, const std::vector<Points> & grids) const;
+
     VectorXd grid_levels;
     VectorXd grid_sides;
     double initial_grid_param;
@@ -72,85 +140,132 @@ class MultiGridAlgorithm : public AlgorithmBase<Model> {
     std::unique_ptr<SingleGridAlgorithm<Model>> inner_algorithm;
 };
 
-template<class Model>
-Grid MultiGridAlgorithm<Model>::create_new_grid_from_pvalues(
-    const Grid & old_grid, const RowVectorXd & p_values, double min_value, int new_grid_side
+template<class Model, class Points>
+Points MultiGridAlgorithm<Model, Points>::create_new_grid_from_pvalues(
+    const Points & old_grid, const RowVectorXd & p_values, double min_value, PointIndex new_grid_side
+) {
+    PointBitset members(p_values.size());
+    for (PointIndex i = 0; i < p_values.size(); i++) {
+        if (p_values(i) >= min_value) {
+            members.set(i);
+        }
+    }
+    if (members.count() == 0) {
+        throw std::runtime_error("No point over min_value = " + std::to_string(min_value) + " found");
+    }
+    return create_new_grid_from_membership(old_grid, members, new_grid_side);
+}
+
+
+template<class Model, class Points>
+Points MultiGridAlgorithm<Model, Points>::create_new_grid_from_membership(
+    const Points & old_grid, const PointBitset & members, PointIndex new_grid_side
 ) {
     const ArrayXd old_start = old_grid.get_start_point(), old_end = old_grid.get_end_point(),
             step_increment = old_grid.get_step_increment();
     bool point_found = false;
     ArrayXd start, end;
-        
-    for (int i = 0; i < old_grid.get_size(); i++) {
-        if (p_values(i) >= min_value) {
-            ArrayXd coords = old_grid.get_point(i).array();
-            if (point_found) {
-                start = start.min(coords - step_increment);
-                end = end.max(coords + step_increment);
-            } else {
-                start = coords - step_increment;
-                end = coords + step_increment;
-            }
 
-            point_found = true;
+    // The coordinates are generated only for the blocks containing some points in the region
+    const PointIndex block_size = PointBitset::word_bits;
+    MatrixXd points(block_size, old_grid.get_dimension());
+    for (PointIndex first = 0; first < old_grid.get_size(); first += block_size) {
+        if (members.get_words()[first / block_size] == 0) {
+            continue;
+        }
+        const PointIndex count = std::min(block_size, old_grid.get_size() - first);
+        old_grid.get_points(first, points.topRows(count));
+        for (PointIndex j = 0; j < count; j++) {
+            if (members.test(first + j)) {
+                const ArrayXd coords = points.row(j).transpose().array();
+                if (point_found) {
+                    start = start.min(coords - step_increment);
+                    end = end.max(coords + step_increment);
+                } else {
+                    start = coords - step_increment;
+                    end = coords + step_increment;
+                }
+
+                point_found = true;
+            }
         }
     }
 
     if (!point_found) {
-        stop("No point over min_value = %d found", min_value);
+        throw std::runtime_error("No point of the grid found in the conformal region");
     }
 
-    return Grid(start.max(old_start), end.min(old_end), new_grid_side);
+    return Points(start.max(old_start), end.min(old_end), new_grid_side);
 }
 
 
-template<class Model>
-List MultiGridAlgorithm<Model>::run(
+template<class Model, class Points>
+BasicMultiGridResult<Points> MultiGridAlgorithm<Model, Points>::run(
     const Model & model,
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat
 ) {
-    if (Xhat.rows() > 1) {
-        stop("You must pass a single Xhat point to multi_grid functions");
-    }
-
     if (grid_levels.size() + 1 != grid_sides.size()) {
-        stop("grid_sides must be one item longer than grid_levels");
+        throw std::invalid_argument("grid_sides must be one item longer than grid_levels");
     }
+    this->reset_diagnostics();
+    inner_algorithm->reset_diagnostics();
 
-    std::vector<List> grid_parameters;
+    // Each Xhat has its own grid and refinement history, but all of them are evaluated together at each level
+    const int n0 = Xhat.rows();
     const VectorXd initial_ylim = initial_grid_param * Y.array().abs().colwise().maxCoeff();
-    Grid grid(-initial_ylim, initial_ylim, grid_sides[0]);
-    grid_parameters.push_back(grid.get_parameters_as_list());
-
-    RowVectorXd p_values;
+    std::vector<Points> grids(n0, Points(-initial_ylim, initial_ylim, grid_sides[0]));
+    BasicMultiGridResult<Points> result;
+    result.grids.resize(n0);
+    std::vector<const PointSet *> grid_pointers(n0);
+    for (int j = 0; j < n0; j++) {
+        result.grids[j].push_back(grids[j]);
+        grid_pointers[j] = &grids[j];
+    }
 
     int i;
     for (i = 0; i < grid_levels.size(); i++) {
         if (print_progress) {
-            std::cout << "Running conformal on grid " << i <<
-                " (grid_side = " << grid.get_grid_side() <<
-                ", start_point = " << grid.get_start_point().transpose() <<
-                ", end_point = " << grid.get_end_point().transpose() <<
-                ")" << std::endl;
+            print_level(i, grids);
         }
+        const double start_time = omp_get_wtime();
 
-        p_values = inner_algorithm->run_on_grid(model, X, Y, Xhat, grid);
-        grid = create_new_grid_from_pvalues(grid, p_values, grid_levels[i], grid_sides[i+1]);
-        grid_parameters.push_back(grid.get_parameters_as_list());
+        // The intermediate levels only need to know which points have a p-value over the level
+        const std::vector<PointBitset> members = inner_algorithm->run_membership_on_grids(
+            model, X, Y, Xhat, grid_pointers, grid_levels[i]
+        );
+        for (int j = 0; j < n0; j++) {
+            grids[j] = create_new_grid_from_membership(grids[j], members[j], grid_sides[i+1]);
+            result.grids[j].push_back(grids[j]);
+        }
+        this->diagnostics.refinement_seconds.push_back(omp_get_wtime() - start_time);
     }
 
     if (print_progress) {
-        std::cout << "Running conformal on grid " << i <<
-            " (grid_side = " << grid.get_grid_side() <<
-            ", start_point = " << grid.get_start_point().transpose() <<
-            ", end_point = " << grid.get_end_point().transpose() <<
+        print_level(i, grids);
+    }
+    const double start_time = omp_get_wtime();
+    result.p_values = inner_algorithm->run_on_grids(model, X, Y, Xhat, grid_pointers);
+    this->diagnostics.refinement_seconds.push_back(omp_get_wtime() - start_time);
+
+    // The timings and counters of the evaluations are collected by the inner algorithm
+    this->diagnostics.merge(inner_algorithm->get_diagnostics());
+    return result;
+}
+
+
+template<class Model, class Points>
+void MultiGridAlgorithm<Model, Points>::print_level(int level, const std::vector<Points> & grids) const {
+    for (size_t j = 0; j < grids.size(); j++) {
+        std::cout << "Running conformal on grid " << level;
+        if (grids.size() > 1) {
+            std::cout << " for Xhat " << j;
+        }
+        std::cout << " (";
+        print_resolution(std::cout, grids[j]);
+        std::cout << ", start_point = " << grids[j].get_start_point().transpose() <<
+            ", end_point = " << grids[j].get_end_point().transpose() <<
             ")" << std::endl;
     }
-    p_values = inner_algorithm->run_on_grid(model, X, Y, Xhat, grid);
-    
-    return List::create(Named("y_grid") = grid.collect(), 
-                        Named("y_grid_parameters") = grid_parameters,
-                        Named("p_values") = p_values);
 }
 
 #endif
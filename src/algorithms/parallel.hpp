@@ -0,0 +1,96 @@
+/*! @file */
+#ifndef __ALGORITHMS__PARALLEL_HPP
+#define __ALGORITHMS__PARALLEL_HPP
+#include <stdexcept>
+#include <string>
+#include <omp.h>
+#include <Eigen/Dense>
+
+/*! Schedule of the parallel evaluation loops (see the OpenMP `schedule` clause).
+*/
+enum class Schedule {
+    Static,
+    Dynamic,
+    Guided
+};
+
+/*! Parse the name of a schedule ("static", "dynamic" or "guided").
+*/
+inline Schedule parse_schedule(const std::string & name) {
+    if (name == "static") {
+        return Schedule::Static;
+    }
+    if (name == "dynamic") {
+        return Schedule::Dynamic;
+    }
+    if (name == "guided") {
+        return Schedule::Guided;
+    }
+    throw std::invalid_argument("Unknown schedule: " + name + " (must be static, dynamic or guided)");
+}
+
+/*! Get the name of a schedule.
+*/
+inline const char * get_schedule_name(Schedule schedule) {
+    switch (schedule) {
+        case Schedule::Dynamic: return "dynamic";
+        case Schedule::Guided: return "guided";
+        default: return "static";
+    }
+}
+
+/*! Threading options of the parallel evaluation loops.
+*/
+struct ParallelOptions {
+    //! Number of threads (0: the OpenMP default, i.e. `omp_get_max_threads()`)
+    int num_threads = 0;
+    //! Schedule of the loops
+    Schedule schedule = Schedule::Static;
+    //! Number of iterations assigned to a thread at a time (0: the OpenMP default for the schedule)
+    int chunk_size = 0;
+
+    /*! Get the number of threads to use.
+    */
+    int get_num_threads() const {
+        return num_threads > 0 ? num_threads : omp_get_max_threads();
+    };
+};
+
+/*! Scope of a parallel evaluation loop, restoring the previous settings when destroyed.
+    While it exists, the loops with `schedule(runtime)` use the schedule of the options, and Eigen and
+    nested OpenMP regions (e.g. a multi-threaded BLAS) run on a single thread, so that each thread of
+    the loop does not start other threads: otherwise, several jobs running side by side oversubscribe the cores.
+*/
+class ParallelScope {
+    public:
+    /*! Apply the options (must be called outside of parallel regions).
+    */
+    ParallelScope(const ParallelOptions & options) {
+        omp_get_schedule(&saved_kind, &saved_chunk_size);
+        saved_eigen_threads = Eigen::nbThreads();
+        saved_max_active_levels = omp_get_max_active_levels();
+
+        const omp_sched_t kind = options.schedule == Schedule::Dynamic ? omp_sched_dynamic :
+                                 options.schedule == Schedule::Guided ? omp_sched_guided : omp_sched_static;
+        omp_set_schedule(kind, options.chunk_size);
+        Eigen::setNbThreads(1);
+        omp_set_max_active_levels(1);
+    };
+
+    ~ParallelScope() {
+        omp_set_schedule(saved_kind, saved_chunk_size);
+        Eigen::setNbThreads(saved_eigen_threads);
+        omp_set_max_active_levels(saved_max_active_levels);
+    };
+
+    ParallelScope(const ParallelScope &) = delete;
+    ParallelScope & operator=(const ParallelScope &) = delete;
+
+    private:
+    omp_sched_t saved_kind;
+    int saved_chunk_size;
+    int saved_eigen_threads;
+    int saved_max_active_levels;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*! @file */
+#ifndef __ALGORITHMS__PREDICTOR_HPP
+#define __ALGORITHMS__PREDICTOR_HPP
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "../grid.hpp"
+#include "residual_engines.hpp"
+#include "single_grid.hpp"
+
+/*! Detects whether a model provides `add_base_observations`, updating the factorisation of `fit_base` with new observations.
+*/
+template<class Model, class = void>
+struct has_base_update : std::false_type {};
+
+template<class Model>
+struct has_base_update<Model, decltype(std::declval<Model &>().add_base_observations(
+    std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>()
+), void())> : has_fit_base<Model> {};
+
+/*! Abstract class for a conformal predictor, holding the training data and the state prepared from it
+    (see @ref ConformalPredictor), so that it can be queried many times, and kept behind a pointer of this type.
+*/
+class ConformalPredictorBase {
+    public:
+    virtual ~ConformalPredictorBase() {};
+
+    /*! Compute the p-values of the grid points for each `Xhat`, with the state prepared from the training data.
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \return The grid and the p-values corresponding to its points
+    */
+    virtual SingleGridResult predict_region(const MatrixXd & Xhat) = 0;
+
+    /*! Add observations to the training data, updating the prepared state.
+        \param X_new matrix of the independent variables of the new observations
+        \param Y_new matrix of the covariates of the new observations
+    */
+    virtual void add_observations(const MatrixXd & X_new, const MatrixXd & Y_new) = 0;
+
+    /*! Get the number of observations of the training data.
+    */
+    virtual int get_size() const = 0;
+
+    /*! Set the threading options of the evaluation (see @ref AlgorithmBase::set_parallel_options).
+    */
+    virtual void set_parallel_options(const ParallelOptions & options) = 0;
+
+    /*! Set the precision of the scores of the evaluation (see @ref AlgorithmBase::set_precision).
+    */
+    virtual void set_precision(Precision precision) = 0;
+
+    /*! Set the monitor of the evaluation (see @ref AlgorithmBase::set_progress_monitor).
+    */
+    virtual void set_progress_monitor(ProgressMonitor * monitor) = 0;
+
+    /*! Get the phase timings and counters of the last call (see @ref RunDiagnostics).
+    */
+    virtual const RunDiagnostics & get_diagnostics() const = 0;
+};
+
+/*! Conformal predictor keeping the training data, the model prepared for it (e.g. the factorisation of the Gram matrix)
+    and the grid between calls, so that each query with a batch of `Xhat` costs only the evaluation of the grid,
+    as in @ref SingleGridAlgorithm::run.
+    New observations update the prepared model incrementally when it provides `add_base_observations`
+    (otherwise, it is prepared again on the whole data), and extend the grid when they fall outside of it.
+    \param Model class model base
+*/
+template<class Model>
+class ConformalPredictor : public ConformalPredictorBase {
+    public:
+    /*! Construct a ConformalPredictor instance, preparing the model for the training data.
+        \param model model to use as a base for conformal regression (will be copied and prepared)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param grid_side number of points for each side of the grid
+        \param grid_param determines the size of the grid (as in @ref SingleGridAlgorithm)
+    */
+    ConformalPredictor(const Model & _model, const DataView & _X, const DataView & _Y, int _grid_side, double _grid_param) :
+        model(_model), X(_X), Y(_Y), grid_side(_grid_side), grid_param(_grid_param),
+        y_abs_max(_Y.array().abs().colwise().maxCoeff().transpose()),
+        grid(make_grid()), algorithm(_grid_side, _grid_param)
+    {
+        if (X.rows() != Y.rows()) {
+            throw std::invalid_argument("X.rows() != y.rows(), but they must be equal (to n)");
+        }
+        ResidualEngine<Model>::prepare_model(model, X, Y);
+    };
+
+    SingleGridResult predict_region(const MatrixXd & Xhat) override {
+        algorithm.reset_diagnostics();
+        return {grid, algorithm.run_on_prepared_grid(model, X, Y, Xhat, grid)};
+    };
+
+    /*! Add observations to the training data, updating the prepared model and the grid.
+        The training data are copied to grow them, in \f$ O(np) \f$, which is much less than preparing the model again.
+    */
+    void add_observations(const MatrixXd & X_new, const MatrixXd & Y_new) override {
+        if (X_new.cols() != X.cols() || Y_new.cols() != Y.cols() || X_new.rows() != Y_new.rows()) {
+            throw std::invalid_argument("The new observations must have the same columns as the training data, and as many rows in X_new as in Y_new");
+        }
+        const Index n = X.rows();
+        X.conservativeResize(n + X_new.rows(), NoChange);
+        X.bottomRows(X_new.rows()) = X_new;
+        Y.conservativeResize(n + Y_new.rows(), NoChange);
+        Y.bottomRows(Y_new.rows()) = Y_new;
+        update_model(X_new, Y_new, has_base_update<Model>());
+
+        const VectorXd new_abs_max = y_abs_max.cwiseMax(Y_new.array().abs().colwise().maxCoeff().transpose().matrix());
+        if (new_abs_max != y_abs_max) {
+            y_abs_max = new_abs_max;
+            grid = make_grid();
+        }
+    };
+
+    int get_size() const override {
+        return X.rows();
+    };
+
+    /*! Get the grid where the p-values are computed.
+    */
+    const Grid & get_grid() const {
+        return grid;
+    };
+
+    void set_parallel_options(const ParallelOptions & options) override {
+        algorithm.set_parallel_options(options);
+    };
+
+    void set_precision(Precision precision) override {
+        algorithm.set_precision(precision);
+    };
+
+    void set_progress_monitor(ProgressMonitor * monitor) override {
+        algorithm.set_progress_monitor(monitor);
+    };
+
+    const RunDiagnostics & get_diagnostics() const override {
+        return algorithm.get_diagnostics();
+    };
+
+    private:
+    void update_model(const MatrixXd & X_new, const MatrixXd & Y_new, std::true_type) {
+        model.add_base_observations(X_new, Y_new);
+    };
+
+    void update_model(const MatrixXd &, const MatrixXd &, std::false_type) {
+        ResidualEngine<Model>::prepare_model(model, X, Y);
+    };
+
+    /*! Build the grid covering the covariates of the training data (as @ref SingleGridAlgorithm::run).
+    */
+    Grid make_grid() const {
+        const VectorXd ylim = grid_param * y_abs_max;
+        return Grid(-ylim, ylim, grid_side);
+    };
+
+    Model model;
+    MatrixXd X;
+    MatrixXd Y;
+    int grid_side;
+    double grid_param;
+    VectorXd y_abs_max;
+    Grid grid;
+    SingleGridAlgorithm<Model> algorithm;
+};
+
+#endif
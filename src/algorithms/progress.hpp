@@ -0,0 +1,119 @@
+/*! @file */
+#ifndef __ALGORITHMS__PROGRESS_HPP
+#define __ALGORITHMS__PROGRESS_HPP
+#include <atomic>
+#include <stdexcept>
+#include <omp.h>
+#include "../point_set.hpp"
+
+/*! Abstract class receiving the progress of the evaluation loops, and deciding whether to cancel them.
+    It is called only by the thread that started the loop (the OpenMP master thread), while the other threads
+    keep working, so that it can safely call non thread-safe APIs (e.g. to check for a user interrupt in R).
+*/
+class ProgressMonitor {
+    public:
+    virtual ~ProgressMonitor() {};
+
+    /*! Report the progress of the current evaluation.
+        \param fraction fraction of the evaluation completed (between 0 and 1)
+        \return Whether the evaluation must be cancelled
+    */
+    virtual bool update(double fraction) = 0;
+};
+
+/*! Monitor forwarding the progress of a part of an evaluation to another monitor, e.g. for a chunk of a grid.
+*/
+class PartialProgressMonitor : public ProgressMonitor {
+    public:
+    /*! Construct a PartialProgressMonitor instance
+        \param monitor monitor receiving the progress of the whole evaluation
+        \param start fraction of the whole evaluation completed before this part
+        \param length fraction of the whole evaluation corresponding to this part
+    */
+    PartialProgressMonitor(ProgressMonitor & _monitor, double _start, double _length) :
+        monitor(_monitor), start(_start), length(_length) {};
+
+    bool update(double fraction) override {
+        return monitor.update(start + fraction * length);
+    };
+
+    private:
+    ProgressMonitor & monitor;
+    double start;
+    double length;
+};
+
+/*! Exception thrown when an evaluation is cancelled by its @ref ProgressMonitor.
+    It is thrown after the end of the parallel loop, once every thread has stopped.
+*/
+class InterruptedError : public std::runtime_error {
+    public:
+    InterruptedError() : std::runtime_error("The evaluation was interrupted") {};
+};
+
+/*! Progress of a parallel loop, shared by its threads.
+    The threads count the completed iterations, skipping the remaining ones once the loop is cancelled,
+    while the master thread polls the monitor at most every @ref LoopProgress::poll_interval seconds.
+    Without a monitor, nothing is counted.
+*/
+class LoopProgress {
+    public:
+    /*! Construct a LoopProgress instance
+        \param monitor monitor to poll (may be null)
+        \param total number of iterations of the loop
+    */
+    LoopProgress(ProgressMonitor * _monitor, PointIndex _total) :
+        monitor(_monitor), total(_total), done(0), cancelled(false), last_poll_time(omp_get_wtime()) {};
+
+    /*! Count completed iterations (thread-safe).
+    */
+    void add_done(PointIndex count) {
+        if (monitor) {
+            done.fetch_add(count, std::memory_order_relaxed);
+        }
+    };
+
+    /*! Report the progress to the monitor, if the poll interval has elapsed (master thread only).
+        \param force poll even if the poll interval has not elapsed
+    */
+    void poll(bool force = false) {
+        if (!monitor || omp_get_thread_num() != 0 || is_cancelled()) {
+            return;
+        }
+        const double now = omp_get_wtime();
+        if (!force && now - last_poll_time < poll_interval) {
+            return;
+        }
+        last_poll_time = now;
+        const double fraction = total > 0 ? double(done.load(std::memory_order_relaxed)) / total : 1.0;
+        if (monitor->update(fraction)) {
+            cancelled.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    /*! Check whether the loop has been cancelled (thread-safe).
+    */
+    bool is_cancelled() const {
+        return cancelled.load(std::memory_order_relaxed);
+    };
+
+    /*! Throw an @ref InterruptedError if the loop has been cancelled (to be called after the loop).
+    */
+    void check() const {
+        if (is_cancelled()) {
+            throw InterruptedError();
+        }
+    };
+
+    //! Minimum time between two polls of the monitor, in seconds
+    static constexpr double poll_interval = 0.1;
+
+    private:
+    ProgressMonitor * monitor;
+    PointIndex total;
+    std::atomic<PointIndex> done;
+    std::atomic<bool> cancelled;
+    double last_poll_time;
+};
+
+#endif
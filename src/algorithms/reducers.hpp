@@ -0,0 +1,205 @@
+/*! @file */
+#ifndef __ALGORITHMS__REDUCERS_HPP
+#define __ALGORITHMS__REDUCERS_HPP
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <Eigen/Dense>
+#include "../point_set.hpp"
+
+/*! Points of a set kept for each `Xhat`, with their p-values, in compressed sparse row format.
+*/
+struct SparsePValues {
+    //! The points kept for the i-th `Xhat` are the ones from `row_pointers[i]` to `row_pointers[i+1] - 1` (n0 + 1)
+    std::vector<PointIndex> row_pointers;
+    //! Indices (in the set) of the kept points
+    std::vector<PointIndex> indices;
+    //! p-values of the kept points
+    std::vector<double> p_values;
+};
+
+/*! Abstract class for a reducer, which receives the p-values of a set of points one chunk at a time,
+    so that the p-values of the whole set never need to be stored.
+*/
+class GridReducer {
+    public:
+    virtual ~GridReducer() {};
+
+    /*! Consume the p-values of a chunk of points.
+        \param points the whole set of points
+        \param first index (in `points`) of the first point of the chunk
+        \param p_values p-values of the chunk (one row for each `Xhat`, one column for each point)
+    */
+    virtual void consume(const PointSet & points, PointIndex first, const MatrixXd & p_values) = 0;
+};
+
+/*! Reducer keeping only the points with p-value greater or equal than alpha.
+*/
+class ThresholdReducer : public GridReducer {
+    public:
+    /*! Construct a ThresholdReducer instance
+        \param alpha minimum p-value of the kept points
+    */
+    ThresholdReducer(double _alpha) : alpha(_alpha) {};
+
+    void consume(const PointSet &, PointIndex first, const MatrixXd & p_values) override {
+        indices.resize(p_values.rows());
+        kept_p_values.resize(p_values.rows());
+        for (int i = 0; i < p_values.rows(); i++) {
+            for (PointIndex j = 0; j < p_values.cols(); j++) {
+                if (p_values(i, j) >= alpha) {
+                    indices[i].push_back(first + j);
+                    kept_p_values[i].push_back(p_values(i, j));
+                }
+            }
+        }
+    };
+
+    /*! Get the kept points of all the `Xhat`, in compressed sparse row format.
+    */
+    SparsePValues get_result() const {
+        SparsePValues result;
+        result.row_pointers.push_back(0);
+        for (size_t i = 0; i < indices.size(); i++) {
+            result.indices.insert(result.indices.end(), indices[i].begin(), indices[i].end());
+            result.p_values.insert(result.p_values.end(), kept_p_values[i].begin(), kept_p_values[i].end());
+            result.row_pointers.push_back(result.indices.size());
+        }
+        return result;
+    };
+
+    /*! Get the indices of the kept points for an `Xhat`.
+    */
+    const std::vector<PointIndex> & get_indices(int row) const {
+        return indices[row];
+    };
+
+    /*! Get the p-values of the kept points for an `Xhat`.
+    */
+    const std::vector<double> & get_p_values(int row) const {
+        return kept_p_values[row];
+    };
+
+    private:
+    double alpha;
+    std::vector<std::vector<PointIndex>> indices;
+    std::vector<std::vector<double>> kept_p_values;
+};
+
+/*! Reducer computing the histogram of the p-values, with bins of equal width in [0, 1].
+*/
+class HistogramReducer : public GridReducer {
+    public:
+    /*! Construct a HistogramReducer instance
+        \param n_bins number of bins
+    */
+    HistogramReducer(int _n_bins) : n_bins(_n_bins) {};
+
+    void consume(const PointSet &, PointIndex, const MatrixXd & p_values) override {
+        if (counts.rows() != p_values.rows()) {
+            counts = MatrixXd::Zero(p_values.rows(), n_bins);
+        }
+        for (PointIndex j = 0; j < p_values.cols(); j++) {
+            for (int i = 0; i < p_values.rows(); i++) {
+                const int bin = std::min(int(p_values(i, j) * n_bins), n_bins - 1);
+                counts(i, bin)++;
+            }
+        }
+    };
+
+    /*! Get the limits of the bins (n_bins + 1).
+    */
+    VectorXd get_breaks() const {
+        return VectorXd::LinSpaced(n_bins + 1, 0, 1);
+    };
+
+    /*! Get the number of points in each bin (one row for each `Xhat`).
+    */
+    const MatrixXd & get_counts() const {
+        return counts;
+    };
+
+    private:
+    int n_bins;
+    MatrixXd counts;
+};
+
+/*! Reducer computing the bounding box of the points with p-value greater or equal than alpha.
+*/
+class BoundingBoxReducer : public GridReducer {
+    public:
+    /*! Construct a BoundingBoxReducer instance
+        \param alpha minimum p-value of the points in the box
+    */
+    BoundingBoxReducer(double _alpha) : alpha(_alpha) {};
+
+    void consume(const PointSet & points, PointIndex first, const MatrixXd & p_values) override {
+        const int d = points.get_dimension();
+        if (counts.size() != p_values.rows()) {
+            const double infinity = std::numeric_limits<double>::infinity();
+            start_points = MatrixXd::Constant(p_values.rows(), d, infinity);
+            end_points = MatrixXd::Constant(p_values.rows(), d, -infinity);
+            counts = VectorXd::Zero(p_values.rows());
+        }
+
+        VectorXd point(d);
+        for (PointIndex j = 0; j < p_values.cols(); j++) {
+            bool is_loaded = false;
+            for (int i = 0; i < p_values.rows(); i++) {
+                if (p_values(i, j) >= alpha) {
+                    if (!is_loaded) {
+                        points.get_point(first + j, point);
+                        is_loaded = true;
+                    }
+                    start_points.row(i) = start_points.row(i).cwiseMin(point.transpose());
+                    end_points.row(i) = end_points.row(i).cwiseMax(point.transpose());
+                    counts(i)++;
+                }
+            }
+        }
+    };
+
+    /*! Get the number of points with p-value greater or equal than alpha for an `Xhat`.
+    */
+    PointIndex get_count(int row) const {
+        return counts.size() > row ? counts(row) : 0;
+    };
+
+    /*! Get the minimum coordinates of the points with p-value greater or equal than alpha for an `Xhat`.
+    */
+    VectorXd get_start_point(int row) const {
+        return start_points.row(row);
+    };
+
+    /*! Get the maximum coordinates of the points with p-value greater or equal than alpha for an `Xhat`.
+    */
+    VectorXd get_end_point(int row) const {
+        return end_points.row(row);
+    };
+
+    /*! Get the number of points in the box for each `Xhat`.
+    */
+    const VectorXd & get_counts() const {
+        return counts;
+    };
+
+    /*! Get the minimum coordinates of the points in the box (one row for each `Xhat`).
+    */
+    const MatrixXd & get_start_points() const {
+        return start_points;
+    };
+
+    /*! Get the maximum coordinates of the points in the box (one row for each `Xhat`).
+    */
+    const MatrixXd & get_end_points() const {
+        return end_points;
+    };
+
+    private:
+    double alpha;
+    MatrixXd start_points;
+    MatrixXd end_points;
+    VectorXd counts;
+};
+
+#endif
@@ -0,0 +1,810 @@
+/*! @file */
+#ifndef __ALGORITHMS__RESIDUAL_ENGINES_HPP
+#define __ALGORITHMS__RESIDUAL_ENGINES_HPP
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <Eigen/Dense>
+#include "../data_view.hpp"
+
+using namespace Eigen;
+
+/*! Detects whether a model provides `fit_base`, factorising the training data once for later updates.
+*/
+template<class Model, class = void>
+struct has_fit_base : std::false_type {};
+
+template<class Model>
+struct has_fit_base<Model, decltype(std::declval<Model &>().fit_base(
+    std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>()
+), void())> : std::true_type {};
+
+/*! Detects whether a model provides `fit_base` and `fit_update`,
+    i.e. whether it can be fitted on the training data augmented with a single observation without a full refit.
+*/
+template<class Model, class = void>
+struct has_rank_one_update : std::false_type {};
+
+template<class Model>
+struct has_rank_one_update<Model, decltype(std::declval<Model &>().fit_update(
+    std::declval<const RowVectorXd &>(), std::declval<const VectorXd &>()
+), void())> : has_fit_base<Model> {};
+
+/*! Detects whether a model provides `fit_base` and `compute_affine_residuals`,
+    i.e. whether the residuals of the augmented fit are affine in the candidate y0.
+*/
+template<class Model, class = void>
+struct has_affine_residuals : std::false_type {};
+
+template<class Model>
+struct has_affine_residuals<Model, decltype(std::declval<Model &>().compute_affine_residuals(
+    std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>(), std::declval<const RowVectorXd &>(),
+    std::declval<MatrixXd &>(), std::declval<VectorXd &>()
+), void())> : has_fit_base<Model> {};
+
+/*! Detects whether a model provides `fit_predict_batch(X, Y, Y0, greater, equal)`, fitting the model on the augmented data
+    for a whole block of candidates y0 of the same `xhat` at once (see @ref RefitResidualEngine::compute_p_values).
+*/
+template<class Model, class = void>
+struct has_fit_predict_batch : std::false_type {};
+
+template<class Model>
+struct has_fit_predict_batch<Model, decltype(std::declval<Model &>().fit_predict_batch(
+    std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>(),
+    std::declval<VectorXi &>(), std::declval<VectorXi &>()
+), void())> : std::true_type {};
+
+/*! Floating point precision of the nonconformity scores of the grid points.
+*/
+enum class Precision {
+    //! Every score is computed in double precision
+    Double,
+    //! The scores of blocks of points are computed in single precision by the engines supporting it (see @ref AffineResidualEngine),
+    //! and the ones too close to the score of the tested point to be compared safely are computed again in double precision,
+    //! so that the p-values are the same as in double precision. The model and its factorisations stay in double precision.
+    Mixed
+};
+
+/*! Parse the name of a precision ("double" or "mixed").
+*/
+inline Precision parse_precision(const std::string & name) {
+    if (name == "double") {
+        return Precision::Double;
+    }
+    if (name == "mixed") {
+        return Precision::Mixed;
+    }
+    throw std::invalid_argument("Unknown precision: " + name + " (must be double or mixed)");
+}
+
+/*! Draw the weight given to ties between nonconformity scores.
+    A fixed seed is used, so that runs are reproducible.
+*/
+inline double draw_tie_breaking() {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> uniform(0.0,1.0);
+    return uniform(generator);
+}
+
+/*! Compute the conformal p-value from the counts of the nonconformity scores greater than and equal to the one of the tested point.
+    The p-value is non-decreasing in both counts (also in floating point arithmetic), so that it can be bounded
+    from partial counts (see @ref ResidualEngineBase::is_conforming).
+    \param greater number of scores greater than the one of the tested point
+    \param equal number of scores equal to the one of the tested point (including itself)
+    \param total number of scores (n+1)
+    \param tie_breaking weight given to the scores equal to the one of the tested point
+    \return The p-value
+*/
+inline double conformal_p_value(long long greater, long long equal, long long total, double tie_breaking) {
+    return (greater + tie_breaking * equal) / double(total);
+}
+
+/*! Compute the conformal p-value from the nonconformity scores of the augmented data set.
+    \param residuals scores of the n+1 points (the last one is the tested point)
+    \param tie_breaking weight given to the scores equal to the one of the tested point
+    \return The p-value
+*/
+inline double conformal_p_value(const ArrayXd & residuals, double tie_breaking) {
+    const double test_residual = residuals(residuals.size() - 1);
+    return conformal_p_value(
+        (residuals > test_residual).count(), (residuals == test_residual).count(), residuals.size(), tie_breaking
+    );
+}
+
+/*! Membership of a region of the covariates in a conformal region, decided from bounds of the nonconformity scores.
+*/
+enum class RegionMembership {
+    //! Some points of the region may be inside the conformal region, and some outside
+    Undecided,
+    //! Every point of the region has a p-value greater or equal than alpha
+    Inside,
+    //! Every point of the region has a p-value less than alpha
+    Outside
+};
+
+/*! Add the bounds of a term \f$ (a + b y)^2 \f$ of a score, for y between `lower` and `upper`, to the bounds of the score.
+    The bounds are widened by a margin much larger than the rounding errors of the computation of the term,
+    so that they also hold for the scores computed by the engines.
+*/
+inline void add_score_term_bounds(double a, double b, double lower, double upper, double & score_lower, double & score_upper) {
+    const double at_lower = a + b * lower, at_upper = a + b * upper;
+    const double magnitude = std::abs(a) + std::abs(b) * std::max(std::abs(lower), std::abs(upper));
+    const double margin = 1e-12 * magnitude * magnitude;
+    score_upper += std::max(at_lower * at_lower, at_upper * at_upper) + margin;
+    if ((at_lower < 0) == (at_upper < 0)) {
+        score_lower += std::min(at_lower * at_lower, at_upper * at_upper);
+    }
+    score_lower -= margin;
+}
+
+/*! Decide the membership of a region from the bounds of the nonconformity scores over it.
+    The scores certainly greater than the one of the tested point give a lower bound of the p-value,
+    the scores that may be greater or equal give an upper bound.
+    \param greater number of scores certainly greater than the one of the tested point
+    \param candidates number of scores that may be greater or equal than the one of the tested point (excluding itself)
+    \param total number of scores (n+1)
+    \param tie_breaking weight given to ties between nonconformity scores
+    \param alpha minimum p-value of the points inside the conformal region
+*/
+inline RegionMembership decide_region(long long greater, long long candidates, long long total, double tie_breaking, double alpha) {
+    // The tested point ties with itself
+    if (conformal_p_value(greater, 1, total, tie_breaking) >= alpha) {
+        return RegionMembership::Inside;
+    }
+    if (conformal_p_value(candidates, candidates + 1, total, tie_breaking) < alpha) {
+        return RegionMembership::Outside;
+    }
+    return RegionMembership::Undecided;
+}
+
+/*! Detects whether an engine provides `classify_region(lower, upper, tie_breaking, alpha)`,
+    bounding its scores over a box of the covariates.
+*/
+template<class Engine, class = void>
+struct has_region_bounds : std::false_type {};
+
+template<class Engine>
+struct has_region_bounds<Engine, decltype(std::declval<Engine &>().classify_region(
+    std::declval<const VectorXd &>(), std::declval<const VectorXd &>(), 0.0, 0.0
+), void())> : std::true_type {};
+
+/*! Decide whether every point of a box of the covariates is inside (or outside) the conformal region at level alpha,
+    with the bounds of the engine, if available.
+    \param engine engine, whose `xhat` has already been set
+    \param lower lower corner of the box
+    \param upper upper corner of the box
+    \param tie_breaking weight given to ties between nonconformity scores
+    \param alpha minimum p-value of the points inside the conformal region
+*/
+template<class Engine, class Vector>
+RegionMembership classify_region(
+    Engine & engine, const Vector & lower, const Vector & upper, double tie_breaking, double alpha, std::true_type
+) {
+    return engine.classify_region(lower, upper, tie_breaking, alpha);
+}
+
+template<class Engine, class Vector>
+RegionMembership classify_region(Engine &, const Vector &, const Vector &, double, double, std::false_type) {
+    return RegionMembership::Undecided;
+}
+
+/*! Detects whether an engine provides `compute_p_values(points, tie_breaking, p_values)`,
+    computing the p-values of a whole block of tested points at once.
+*/
+template<class Engine, class = void>
+struct has_batch_p_values : std::false_type {};
+
+template<class Engine>
+struct has_batch_p_values<Engine, decltype(std::declval<Engine &>().compute_p_values(
+    std::declval<const MatrixXd &>(), 0.0, std::declval<VectorXd &>()
+), void())> : std::true_type {};
+
+/*! Base class for the residual engines, computing the p-value of a tested point from its nonconformity scores.
+    Engines are used by @ref SingleGridAlgorithm through `set_xhat(xhat)`, `compute_p_value(y0, tie_breaking)`
+    and `is_conforming(y0, tie_breaking, alpha)`:
+    each thread works on its own copy of an engine.
+    Engines can also provide `compute_p_values(points, tie_breaking, p_values)` for a block of tested points
+    (see @ref has_batch_p_values), to reuse their data across the points of the block.
+    \param Derived engine class, providing `compute_residuals(y0)`
+*/
+template<class Derived>
+class ResidualEngineBase {
+    public:
+    /*! Compute the conformal p-value of the tested point (xhat, y0).
+        \param y0 covariates of the tested point
+        \param tie_breaking weight given to ties between nonconformity scores
+        \return The p-value
+    */
+    template<class Vector>
+    double compute_p_value(const Vector & y0, double tie_breaking) {
+        return conformal_p_value(static_cast<Derived *>(this)->compute_residuals(y0), tie_breaking);
+    };
+
+    /*! Check whether the tested point (xhat, y0) is inside the conformal region at level alpha, i.e. its p-value is at least alpha.
+        Engines whose scores are cheap with respect to the fit can override it, to stop counting the scores once the outcome is decided.
+        \param y0 covariates of the tested point
+        \param tie_breaking weight given to ties between nonconformity scores
+        \param alpha minimum p-value of the points inside the conformal region
+    */
+    template<class Vector>
+    bool is_conforming(const Vector & y0, double tie_breaking, double alpha) {
+        return compute_p_value(y0, tie_breaking) >= alpha;
+    };
+
+    /*! Set the precision of the scores (see @ref Precision).
+        Engines without a single precision evaluation ignore it, and always compute the scores in double precision.
+    */
+    void set_precision(Precision) {};
+
+    /*! Get the number of model fits (or updates) performed by this engine.
+    */
+    long long get_fit_count() const {
+        return fit_count;
+    };
+
+    /*! Get the number of scores computed again in double precision by this engine (see @ref Precision::Mixed).
+    */
+    long long get_recheck_count() const {
+        return recheck_count;
+    };
+
+    protected:
+    long long fit_count = 0;
+    long long recheck_count = 0;
+};
+
+/*! Detects whether a model provides `predict_into`, writing its predictions in existing storage.
+*/
+template<class Model, class = void>
+struct has_predict_into : std::false_type {};
+
+template<class Model>
+struct has_predict_into<Model, decltype(std::declval<Model &>().predict_into(
+    std::declval<const MatrixXd &>(), std::declval<MatrixXd &>()
+), void())> : std::true_type {};
+
+template<class Model, class Output>
+void predict_into(Model & model, const DataView & X, Output & fitted_values, std::true_type) {
+    model.predict_into(X, fitted_values);
+}
+
+template<class Model, class Output>
+void predict_into(Model & model, const DataView & X, Output & fitted_values, std::false_type) {
+    fitted_values = model.predict(X);
+}
+
+/*! Residual engine that refits the model for each tested point.
+    Works with every model exposing `fit` and `predict`.
+    Each engine is a per-thread workspace: the augmented data set, the model and the fitted values
+    are allocated once, and only the row of the tested point is overwritten.
+    Since `fit` takes a single matrix, each thread holds its own copy of X and Y with the added row,
+    i.e. \f$ O(n(p + d)) \f$ memory per thread, unlike the other engines, which read them in place.
+    Models can also provide `fit_predict_batch(X, Y, Y0, greater, equal)`: given the augmented data (X, Y), whose last row of Y
+    is replaced by each candidate y0 (the rows of Y0), it writes for each candidate the number of residual norms greater than
+    (in `greater`) and equal to (in `equal`, counting itself) the one of the last row, so that the residuals of the whole block
+    are never stored. The candidates share the same X, so that the work that does not depend on y0 (e.g. factorising the
+    Gram matrix) is done once for the block, and the rest can be done with matrix-matrix products over all the candidates.
+    \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+*/
+template<class Model, int D = Dynamic>
+class RefitResidualEngine : public ResidualEngineBase<RefitResidualEngine<Model, D>> {
+    public:
+    /*! Prepare the model before copying it to the engines (nothing to do, since it is refitted at each point).
+    */
+    static void prepare_model(Model &, const DataView &, const DataView &) {};
+
+    //! Number of model fits performed by @ref RefitResidualEngine::prepare_model
+    static const int prepare_fits = 0;
+
+    /*! Construct an engine for the training data (X, Y).
+        \param model model to use as a base for conformal regression (will be copied once, and refitted at each point)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+    */
+    RefitResidualEngine(const Model & _model, const DataView & X, const DataView & Y) :
+        model(_model), n(X.rows()),
+        regression_matrix(X.rows() + 1, X.cols()),
+        regression_vector(Y.rows() + 1, Y.cols()),
+        fitted_values(Y.rows() + 1, Y.cols()),
+        residuals(Y.rows() + 1)
+    {
+        regression_matrix << X, RowVectorXd::Zero(X.cols());
+        regression_vector << Y, RowVectorXd::Zero(Y.cols());
+    };
+
+    /*! Set the values of the independent variables for the tested point.
+    */
+    void set_xhat(const RowVectorXd & xhat) {
+        regression_matrix.row(n) = xhat;
+    };
+
+    /*! Compute the nonconformity scores of the augmented data set, where the tested point is (xhat, y0).
+        \return The scores, the last one corresponding to the tested point
+    */
+    const ArrayXd & compute_residuals(const Matrix<double, D, 1> & y0) {
+        regression_vector.row(n) = y0;
+
+        model.fit(regression_matrix, regression_vector);
+        this->fit_count++;
+        predict_into(model, regression_matrix, fitted_values, has_predict_into<Model>());
+        residuals = (regression_vector - fitted_values).rowwise().norm().array();
+        return residuals;
+    };
+
+    /*! Compute the conformal p-values of a block of tested points (xhat, y0), the covariates y0 being the rows of `points`,
+        with a single call to the `fit_predict_batch` of the model (only for the models providing it).
+        \param points covariates of the tested points (one row for each point)
+        \param tie_breaking weight given to ties between nonconformity scores
+        \param p_values output vector (one p-value for each point)
+    */
+    template<class Points, class Output, class M = Model, typename std::enable_if<has_fit_predict_batch<M>::value, int>::type = 0>
+    void compute_p_values(const Points & points, double tie_breaking, Output & p_values) {
+        model.fit_predict_batch(regression_matrix, regression_vector, points, batch_greater, batch_equal);
+        this->fit_count += points.rows();
+        for (Index j = 0; j < points.rows(); j++) {
+            p_values(j) = conformal_p_value(batch_greater(j), batch_equal(j), n + 1, tie_breaking);
+        }
+    };
+
+    private:
+    Model model;
+    int n;
+    MatrixXd regression_matrix;
+    Matrix<double, Dynamic, D> regression_vector;
+    Matrix<double, Dynamic, D> fitted_values;
+    ArrayXd residuals;
+    VectorXi batch_greater;
+    VectorXi batch_equal;
+};
+
+/*! Residual engine for models supporting rank-one updates.
+    The base data are factorised once (by @ref UpdateResidualEngine::prepare_model) and each tested point
+    only updates the fit with the added observation, then predicts the n rows of X (read in place) and the row of `xhat`.
+    \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+*/
+template<class Model, int D = Dynamic>
+class UpdateResidualEngine : public ResidualEngineBase<UpdateResidualEngine<Model, D>> {
+    public:
+    /*! Fit the model on the base data, before copying it to the engines.
+    */
+    static void prepare_model(Model & model, const DataView & X, const DataView & Y) {
+        model.fit_base(X, Y);
+    };
+
+    //! Number of model fits performed by @ref UpdateResidualEngine::prepare_model
+    static const int prepare_fits = 1;
+
+    /*! Construct an engine for the training data (X, Y).
+        \param model model already prepared by @ref UpdateResidualEngine::prepare_model (will be copied once)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+    */
+    UpdateResidualEngine(const Model & _model, const DataView & _X, const DataView & _Y) :
+        model(_model), X(_X), Y(_Y),
+        xhat(_X.cols()),
+        fitted_values(_Y.rows(), _Y.cols()),
+        xhat_fitted_values(1, _Y.cols()),
+        residuals(_Y.rows() + 1)
+    {};
+
+    /*! Set the values of the independent variables for the tested point.
+    */
+    void set_xhat(const RowVectorXd & _xhat) {
+        xhat = _xhat;
+    };
+
+    /*! Compute the nonconformity scores of the augmented data set, where the tested point is (xhat, y0).
+        \return The scores, the last one corresponding to the tested point
+    */
+    const ArrayXd & compute_residuals(const Matrix<double, D, 1> & y0) {
+        const Index n = X.rows();
+        model.fit_update(xhat, y0);
+        this->fit_count++;
+        predict_into(model, X, fitted_values, has_predict_into<Model>());
+        predict_into(model, Map<const MatrixXd>(xhat.data(), 1, xhat.size()), xhat_fitted_values, has_predict_into<Model>());
+        residuals.head(n) = (Y - fitted_values).rowwise().norm().array();
+        residuals(n) = (y0.transpose() - xhat_fitted_values).norm();
+        return residuals;
+    };
+
+    private:
+    Model model;
+    DataView X;
+    DataView Y;
+    RowVectorXd xhat;
+    Matrix<double, Dynamic, D> fitted_values;
+    Matrix<double, 1, D> xhat_fitted_values;
+    ArrayXd residuals;
+};
+
+/*! Computation of the affine scores \f$ \sum_k (a_{ik} + b_i y_{0k})^2 \f$ of @ref AffineResidualEngine,
+    for the rows from `first` to `first + count - 1`.
+    For a dimension known at compile time, the sum over k is unrolled in a single vectorised expression,
+    so that the scores are computed in a single pass.
+    \param D number of covariates d, or `Dynamic`
+    \param Scalar floating point type of the computation (`float` for the single precision scores of @ref Precision::Mixed)
+*/
+template<int D, class Scalar = double>
+struct AffineScores {
+    static void compute(
+        const Matrix<Scalar, Dynamic, Dynamic> & intercept, const Matrix<Scalar, Dynamic, 1> & slope, const Matrix<Scalar, D, 1> & y0,
+        Array<Scalar, Dynamic, 1> & scores, Index first, Index count
+    ) {
+        scores.segment(first, count) = (intercept.col(0).segment(first, count).array() + slope.segment(first, count).array() * y0(0)).square();
+        for (int k = 1; k < y0.size(); k++) {
+            scores.segment(first, count) += (intercept.col(k).segment(first, count).array() + slope.segment(first, count).array() * y0(k)).square();
+        }
+    };
+};
+
+template<class Scalar>
+struct AffineScores<1, Scalar> {
+    static void compute(
+        const Matrix<Scalar, Dynamic, Dynamic> & intercept, const Matrix<Scalar, Dynamic, 1> & slope, const Matrix<Scalar, 1, 1> & y0,
+        Array<Scalar, Dynamic, 1> & scores, Index first, Index count
+    ) {
+        scores.segment(first, count) = (intercept.col(0).segment(first, count).array() + slope.segment(first, count).array() * y0(0)).square();
+    };
+};
+
+template<class Scalar>
+struct AffineScores<2, Scalar> {
+    static void compute(
+        const Matrix<Scalar, Dynamic, Dynamic> & intercept, const Matrix<Scalar, Dynamic, 1> & slope, const Matrix<Scalar, 2, 1> & y0,
+        Array<Scalar, Dynamic, 1> & scores, Index first, Index count
+    ) {
+        const auto b = slope.segment(first, count).array();
+        scores.segment(first, count) = (intercept.col(0).segment(first, count).array() + b * y0(0)).square()
+                                     + (intercept.col(1).segment(first, count).array() + b * y0(1)).square();
+    };
+};
+
+template<class Scalar>
+struct AffineScores<3, Scalar> {
+    static void compute(
+        const Matrix<Scalar, Dynamic, Dynamic> & intercept, const Matrix<Scalar, Dynamic, 1> & slope, const Matrix<Scalar, 3, 1> & y0,
+        Array<Scalar, Dynamic, 1> & scores, Index first, Index count
+    ) {
+        const auto b = slope.segment(first, count).array();
+        scores.segment(first, count) = (intercept.col(0).segment(first, count).array() + b * y0(0)).square()
+                                     + (intercept.col(1).segment(first, count).array() + b * y0(1)).square()
+                                     + (intercept.col(2).segment(first, count).array() + b * y0(2)).square();
+    };
+};
+
+/*! Residual engine for models whose augmented residuals are affine in y0 (linear and ridge regression).
+    The base data are factorised once; for each `Xhat` row the factorisation is updated, obtaining the residuals as
+    \f$ r_k(y_0) = a_k + b_k y_0 \f$, so that each tested point costs \f$ O(nd) \f$.
+    Squared norms are used as scores, since they preserve the ordering.
+    \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+*/
+template<class Model, int D = Dynamic>
+class AffineResidualEngine : public ResidualEngineBase<AffineResidualEngine<Model, D>> {
+    public:
+    /*! Fit the model on the base data, before copying it to the engines.
+    */
+    static void prepare_model(Model & model, const DataView & X, const DataView & Y) {
+        model.fit_base(X, Y);
+    };
+
+    //! Number of model fits performed by @ref AffineResidualEngine::prepare_model
+    static const int prepare_fits = 1;
+
+    /*! Construct an engine for the training data (X, Y).
+        \param model model already prepared by @ref AffineResidualEngine::prepare_model
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+    */
+    AffineResidualEngine(const Model & _model, const DataView & _X, const DataView & _Y) :
+        model(_model), X(_X), Y(_Y), residuals(_X.rows() + 1) {};
+
+    /*! Set the values of the independent variables for the tested point, updating the factorisation.
+    */
+    void set_xhat(const RowVectorXd & xhat) {
+        model.compute_affine_residuals(X, Y, xhat, intercept, slope);
+        this->fit_count++;
+        if (precision == Precision::Mixed) {
+            prepare_single_precision();
+        }
+    };
+
+    /*! Set the precision of the scores computed by @ref AffineResidualEngine::compute_p_values (see @ref Precision).
+    */
+    void set_precision(Precision _precision) {
+        precision = _precision;
+    };
+
+    /*! Compute the nonconformity scores of the augmented data set, where the tested point is (xhat, y0).
+        \return The scores, the last one corresponding to the tested point
+    */
+    const ArrayXd & compute_residuals(const Matrix<double, D, 1> & y0) {
+        AffineScores<D>::compute(intercept, slope, y0, residuals, 0, residuals.size());
+        return residuals;
+    };
+
+    /*! Compute the conformal p-values of a block of tested points (xhat, y0), the covariates y0 being the rows of `points`.
+        The scores are computed and counted @ref AffineResidualEngine::batch_tile_size rows at a time for every point of the block,
+        so that each tile of the intercepts and slopes is read from memory once for the whole block, instead of once for each point.
+        The p-values are the same as the ones of @ref ResidualEngineBase::compute_p_value, also with @ref Precision::Mixed
+        (see @ref AffineResidualEngine::count_single_precision).
+        \param points covariates of the tested points (one row for each point)
+        \param tie_breaking weight given to ties between nonconformity scores
+        \param p_values output vector (one p-value for each point)
+    */
+    template<class Points, class Output>
+    void compute_p_values(const Points & points, double tie_breaking, Output & p_values) {
+        const Index n = residuals.size() - 1, count = points.rows();
+        Matrix<double, D, 1> y0(points.cols());
+        batch_test_scores.resize(count);
+        for (Index j = 0; j < count; j++) {
+            y0 = points.row(j).transpose();
+            AffineScores<D>::compute(intercept, slope, y0, residuals, n, 1);
+            batch_test_scores(j) = residuals(n);
+        }
+
+        // The tested points tie with themselves
+        batch_greater.setZero(count);
+        batch_equal.setOnes(count);
+        const Index tile_size = batch_tile_size;
+        for (Index first = 0; first < n; first += tile_size) {
+            const Index tile_count = std::min(tile_size, n - first);
+            for (Index j = 0; j < count; j++) {
+                y0 = points.row(j).transpose();
+                if (precision == Precision::Mixed &&
+                    count_single_precision(y0, batch_test_scores(j), first, tile_count, batch_greater(j), batch_equal(j))) {
+                    continue;
+                }
+                AffineScores<D>::compute(intercept, slope, y0, residuals, first, tile_count);
+                batch_greater(j) += (residuals.segment(first, tile_count) > batch_test_scores(j)).count();
+                batch_equal(j) += (residuals.segment(first, tile_count) == batch_test_scores(j)).count();
+            }
+        }
+        for (Index j = 0; j < count; j++) {
+            p_values(j) = conformal_p_value(batch_greater(j), batch_equal(j), n + 1, tie_breaking);
+        }
+    };
+
+    /*! Check whether the tested point (xhat, y0) is inside the conformal region at level alpha.
+        The scores are computed and counted @ref AffineResidualEngine::membership_block_size rows at a time,
+        stopping as soon as the remaining rows cannot change the outcome.
+        See @ref ResidualEngineBase::is_conforming.
+    */
+    bool is_conforming(const Matrix<double, D, 1> & y0, double tie_breaking, double alpha) {
+        const Index n = residuals.size() - 1;
+        AffineScores<D>::compute(intercept, slope, y0, residuals, n, 1);
+        const double test_residual = residuals(n);
+
+        // The tested point ties with itself
+        long long greater = 0, equal = 1;
+        const Index block_size = membership_block_size;
+        for (Index first = 0; first < n; first += block_size) {
+            const Index count = std::min(block_size, n - first);
+            AffineScores<D>::compute(intercept, slope, y0, residuals, first, count);
+            greater += (residuals.segment(first, count) > test_residual).count();
+            equal += (residuals.segment(first, count) == test_residual).count();
+
+            const Index remaining = n - first - count;
+            if (conformal_p_value(greater, equal, n + 1, tie_breaking) >= alpha) {
+                return true;
+            }
+            if (conformal_p_value(greater + remaining, equal + remaining, n + 1, tie_breaking) < alpha) {
+                return false;
+            }
+        }
+        return conformal_p_value(greater, equal, n + 1, tie_breaking) >= alpha;
+    };
+
+    /*! Decide whether every point of a box of the covariates is inside (or outside) the conformal region at level alpha,
+        bounding each score \f$ \sum_k (a_{ik} + b_i y_{0k})^2 \f$ over the box, for \f$ O(nd) \f$ operations.
+        \param lower lower corner of the box
+        \param upper upper corner of the box
+        \param tie_breaking weight given to ties between nonconformity scores
+        \param alpha minimum p-value of the points inside the conformal region
+    */
+    template<class Vector>
+    RegionMembership classify_region(const Vector & lower, const Vector & upper, double tie_breaking, double alpha) const {
+        const Index n = slope.size() - 1;
+        double test_lower = 0, test_upper = 0;
+        for (Index k = 0; k < intercept.cols(); k++) {
+            add_score_term_bounds(intercept(n, k), slope(n), lower(k), upper(k), test_lower, test_upper);
+        }
+
+        long long greater = 0, candidates = 0;
+        for (Index i = 0; i < n; i++) {
+            double score_lower = 0, score_upper = 0;
+            for (Index k = 0; k < intercept.cols(); k++) {
+                add_score_term_bounds(intercept(i, k), slope(i), lower(k), upper(k), score_lower, score_upper);
+            }
+            greater += score_lower > test_upper;
+            candidates += score_upper >= test_lower;
+        }
+        return decide_region(greater, candidates, n + 1, tie_breaking, alpha);
+    };
+
+    /*! Get the intercepts \f$ a_k \f$ of the residuals for the current `xhat` ((n+1) x d).
+    */
+    const MatrixXd & get_intercept() const {
+        return intercept;
+    };
+
+    /*! Get the slopes \f$ b_k \f$ of the residuals for the current `xhat` (n+1).
+    */
+    const VectorXd & get_slope() const {
+        return slope;
+    };
+
+    //! Number of scores computed at a time by @ref AffineResidualEngine::is_conforming
+    static const Index membership_block_size = 256;
+
+    //! Number of scores computed at a time for each point by @ref AffineResidualEngine::compute_p_values
+    static const Index batch_tile_size = 1024;
+
+    //! Largest bound of the scores of a tile that is computed in single precision (far from the overflow of `float`);
+    //! the smallest one is its inverse (far from the underflow, where the scores would all be computed again)
+    static constexpr double single_precision_limit = 1e30;
+
+    private:
+    /*! Convert the intercepts and slopes of the current `xhat` to single precision, and bound their absolute values
+        over each tile of @ref AffineResidualEngine::batch_tile_size rows.
+    */
+    void prepare_single_precision() {
+        const Index n = slope.size() - 1, tile_size = batch_tile_size, n_tiles = (n + tile_size - 1) / tile_size;
+        intercept_single = intercept.cast<float>();
+        slope_single = slope.cast<float>();
+        scores_single.resize(n + 1);
+        tile_intercept_bounds.resize(intercept.cols(), n_tiles);
+        tile_slope_bounds.resize(n_tiles);
+        for (Index t = 0; t < n_tiles; t++) {
+            const Index first = t * tile_size, count = std::min(tile_size, n - first);
+            tile_intercept_bounds.col(t) = intercept.middleRows(first, count).cwiseAbs().colwise().maxCoeff().transpose();
+            tile_slope_bounds(t) = slope.segment(first, count).cwiseAbs().maxCoeff();
+        }
+    };
+
+    /*! Count the scores of a tile greater than and equal to the one of the tested point, computing them in single precision.
+        The rounding errors of a single precision score \f$ \sum_k (a_{ik} + b_i y_{0k})^2 \f$ are below
+        \f$ (d + 9) u \sum_k (|a_{ik}| + |b_i| |y_{0k}|)^2 \f$, with \f$ u = 2^{-24} \f$: the scores farther than twice this bound
+        (over the tile) from the one of the tested point are compared in single precision, and the closer ones are computed
+        again in double precision, so that the counts are the same as in double precision.
+        \param y0 covariates of the tested point
+        \param test_score score of the tested point (in double precision)
+        \param first first row of the tile
+        \param count number of rows of the tile
+        \param greater incremented by the number of scores greater than the one of the tested point
+        \param equal incremented by the number of scores equal to the one of the tested point
+        \return false (without counting) when the scores of the tile are too large or too small for single precision
+    */
+    bool count_single_precision(
+        const Matrix<double, D, 1> & y0, double test_score, Index first, Index count, long long & greater, long long & equal
+    ) {
+        const Index tile = first / batch_tile_size;
+        double magnitude = 0;
+        for (Index k = 0; k < y0.size(); k++) {
+            const double term = tile_intercept_bounds(k, tile) + tile_slope_bounds(tile) * std::abs(y0(k));
+            magnitude += term * term;
+        }
+        const double bound = magnitude + test_score;
+        if (!(bound < single_precision_limit && bound > 1 / single_precision_limit)) {
+            return false;
+        }
+        const double margin = 2 * (y0.size() + 9) * std::ldexp(1.0, -24) * bound + std::numeric_limits<float>::min();
+        const float lower = float(test_score - margin), upper = float(test_score + margin);
+
+        const Matrix<float, D, 1> y0_single = y0.template cast<float>();
+        AffineScores<D, float>::compute(intercept_single, slope_single, y0_single, scores_single, first, count);
+        const auto tile_scores = scores_single.segment(first, count);
+        const Index above = (tile_scores > upper).count(), close = (tile_scores >= lower).count() - above;
+        greater += above;
+        if (close > 0) {
+            for (Index i = first; i < first + count; i++) {
+                if (scores_single(i) >= lower && scores_single(i) <= upper) {
+                    AffineScores<D>::compute(intercept, slope, y0, residuals, i, 1);
+                    greater += residuals(i) > test_score;
+                    equal += residuals(i) == test_score;
+                }
+            }
+            this->recheck_count += close;
+        }
+        return true;
+    };
+
+    Model model;
+    DataView X;
+    DataView Y;
+    MatrixXd intercept;
+    VectorXd slope;
+    ArrayXd residuals;
+    ArrayXd batch_test_scores;
+    Array<long long, Dynamic, 1> batch_greater;
+    Array<long long, Dynamic, 1> batch_equal;
+    Precision precision = Precision::Double;
+    // Single precision copies of the intercepts and slopes, with their bounds over each tile (for Precision::Mixed)
+    Matrix<float, Dynamic, Dynamic> intercept_single;
+    Matrix<float, Dynamic, 1> slope_single;
+    Array<float, Dynamic, 1> scores_single;
+    MatrixXd tile_intercept_bounds;
+    VectorXd tile_slope_bounds;
+};
+
+/*! Residual engine selected for a model: the affine one when available,
+    then the one based on rank-one updates, and the refit one otherwise.
+    \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+*/
+template<class Model, int D = Dynamic>
+using ResidualEngine = typename std::conditional<
+    has_affine_residuals<Model>::value,
+    AffineResidualEngine<Model, D>,
+    typename std::conditional<
+        has_rank_one_update<Model>::value,
+        UpdateResidualEngine<Model, D>,
+        RefitResidualEngine<Model, D>
+    >::type
+>::type;
+
+/*! Detects whether a model provides `is_base_singular()`, reporting that the factorisation of the base data prepared by
+    `fit_base` is singular.
+*/
+template<class Model, class = void>
+struct has_base_singularity : std::false_type {};
+
+template<class Model>
+struct has_base_singularity<Model, decltype(std::declval<const Model &>().is_base_singular(), void())> : std::true_type {};
+
+template<class Model>
+bool is_base_singular(const Model & model, std::true_type) {
+    return model.is_base_singular();
+}
+
+template<class Model>
+bool is_base_singular(const Model &, std::false_type) {
+    return false;
+}
+
+/*! Construct the @ref ResidualEngine of a prepared model, and call a function with it.
+    When the factorisation of the base data is singular (e.g. linear regression with p > n), its updates do not match
+    a refit on the augmented data: the @ref RefitResidualEngine is used instead, so that the p-values are the ones of a refit.
+    \param model model already prepared by `ResidualEngine<Model>::prepare_model`
+    \param X matrix of the independent variables
+    \param Y matrix of the covariates
+    \param function function to call, e.g. a generic lambda taking the engine by reference
+    \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+    \return The value returned by the function
+*/
+template<int D, class Model, class Function>
+auto with_residual_engine(const Model & model, const DataView & X, const DataView & Y, Function function)
+    -> decltype(function(std::declval<RefitResidualEngine<Model, D> &>())) {
+    if (is_base_singular(model, has_base_singularity<Model>())) {
+        RefitResidualEngine<Model, D> engine(model, X, Y);
+        return function(engine);
+    }
+    ResidualEngine<Model, D> engine(model, X, Y);
+    return function(engine);
+}
+
+//! Largest number of covariates d with a specialised (fixed-size) evaluation, see @ref dispatch_dimension
+const int max_fixed_dimension = 3;
+
+/*! Call a function with the number of covariates d as a compile-time constant, for the small values of d
+    (up to @ref max_fixed_dimension), and with `Dynamic` otherwise.
+    The function receives a `std::integral_constant<int, D>`, e.g. a generic lambda reading `decltype(dimension)::value`:
+    with a fixed D, the vectors of the covariates do not need heap allocations, and the loops over them are unrolled.
+    \param d number of covariates
+    \param function function to call
+    \return The value returned by the function
+*/
+template<class Function>
+auto dispatch_dimension(int d, Function function) -> decltype(function(std::integral_constant<int, Dynamic>())) {
+    switch (d) {
+        case 1: return function(std::integral_constant<int, 1>());
+        case 2: return function(std::integral_constant<int, 2>());
+        case 3: return function(std::integral_constant<int, 3>());
+        default: return function(std::integral_constant<int, Dynamic>());
+    }
+}
+
+#endif
@@ -0,0 +1,253 @@
+/*! @file */
+#ifndef __ALGORITHMS__SHARDS_HPP
+#define __ALGORITHMS__SHARDS_HPP
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "../grid.hpp"
+#include "single_grid.hpp"
+
+/*! p-values of a range of consecutive points of a grid, evaluated by one worker (see @ref evaluate_grid_shard),
+    so that a grid can be split among several processes, possibly on different machines, and merged afterwards
+    (see @ref merge_shards).
+*/
+struct GridShard {
+    //! Start point of the grid
+    VectorXd start_point;
+    //! End point of the grid
+    VectorXd end_point;
+    //! Number of points for each side of the grid
+    int grid_side;
+    //! Index of the first point of the range
+    PointIndex first;
+    //! p-values of the points of the range (one row for each `Xhat`, one column for each point)
+    MatrixXd p_values;
+    //! Fingerprint of the training data, `Xhat`, model and precision of the evaluation (see @ref ShardFingerprint)
+    std::uint64_t fingerprint;
+};
+
+/*! Fingerprint of the inputs of the shards of a grid, so that shards evaluated with different training data, `Xhat`,
+    model or precision are not merged: a 64-bit FNV-1a hash of their shapes and values, taken 64 bits at a time.
+*/
+class ShardFingerprint {
+    public:
+    /*! Add an integer (e.g. a dimension, or an identifier of the model) to the hash.
+    */
+    void add(std::uint64_t word) {
+        value = (value ^ word) * prime;
+    };
+
+    /*! Add a number (e.g. a parameter of the model) to the hash, with its exact bit pattern.
+    */
+    void add(double number) {
+        std::uint64_t word;
+        std::memcpy(&word, &number, sizeof(word));
+        add(word);
+    };
+
+    /*! Add the shape and the values of a matrix to the hash.
+    */
+    void add(const Ref<const MatrixXd> & matrix) {
+        add(std::uint64_t(matrix.rows()));
+        add(std::uint64_t(matrix.cols()));
+        for (Index j = 0; j < matrix.cols(); j++) {
+            for (Index i = 0; i < matrix.rows(); i++) {
+                add(matrix(i, j));
+            }
+        }
+    };
+
+    /*! Get the hash of the values added so far.
+    */
+    std::uint64_t get_value() const {
+        return value;
+    };
+
+    private:
+    static const std::uint64_t prime = 1099511628211ULL;
+    std::uint64_t value = 14695981039346656037ULL;
+};
+
+/*! Evaluate the p-values of a range of consecutive points of a grid, e.g. of the grid of @ref SingleGridAlgorithm::run
+    or of a level of @ref MultiGridAlgorithm::run, with the threading options and precision of the algorithm.
+    Every worker must use the same training data, `Xhat`, model, precision and grid: the shard records a fingerprint
+    of the first ones, checked by @ref merge_shards.
+    \param algorithm single-grid algorithm evaluating the range (its diagnostics are reset)
+    \param model model to use as a base for conformal regression
+    \param fingerprint fingerprint of the model and its parameters, completed with the training data, `Xhat` and precision
+    \param X matrix of the independent variables
+    \param Y matrix of the covariates
+    \param Xhat a matrix containing one or more points to use as values for the independent variables
+    \param grid grid to evaluate
+    \param first index of the first point of the range
+    \param count number of points of the range
+    \return The shard with the p-values of the range
+*/
+template<class Model>
+GridShard evaluate_grid_shard(
+    SingleGridAlgorithm<Model> & algorithm, const Model & model, ShardFingerprint fingerprint,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const Grid & grid, PointIndex first, PointIndex count
+) {
+    if (first < 0 || count < 1 || count > grid.get_size() - first) {
+        throw std::out_of_range("The range of a shard must contain at least one point, and be inside of the grid");
+    }
+    algorithm.reset_diagnostics();
+    const PointRange range(grid, first, count);
+    fingerprint.add(X);
+    fingerprint.add(Y);
+    fingerprint.add(Xhat);
+    fingerprint.add(std::uint64_t(algorithm.get_precision()));
+    return {grid.get_start_point(), grid.get_end_point(), grid.get_grid_side(), first,
+            algorithm.run_on_grid(model, X, Y, Xhat, range), fingerprint.get_value()};
+}
+
+/*! Binary format of the shards: a header identifying the format, the dimensions of the shard and its grid
+    and the fingerprint of its inputs, followed by the coordinates of the corners of the grid and the p-values (column by column), as doubles.
+    The numbers are written with the byte order of the machine: shards are merged on machines with the same byte order.
+*/
+class GridShardFile {
+    public:
+    /*! Write a shard to a file.
+        \param shard shard to write
+        \param path path of the file (overwritten)
+    */
+    static void write(const GridShard & shard, const std::string & path) {
+        std::ofstream stream(path, std::ios::binary);
+        if (!stream) {
+            throw std::runtime_error("Cannot open the shard file " + path);
+        }
+        stream.write(magic, magic_size);
+        write_value(stream, version);
+        write_value(stream, std::int32_t(shard.start_point.size()));
+        write_value(stream, std::int32_t(shard.grid_side));
+        write_value(stream, std::int64_t(shard.p_values.rows()));
+        write_value(stream, std::int64_t(shard.first));
+        write_value(stream, std::int64_t(shard.p_values.cols()));
+        write_value(stream, shard.fingerprint);
+        write_values(stream, shard.start_point.data(), shard.start_point.size());
+        write_values(stream, shard.end_point.data(), shard.end_point.size());
+        write_values(stream, shard.p_values.data(), shard.p_values.size());
+        if (!stream.flush()) {
+            throw std::runtime_error("Cannot write the shard file " + path);
+        }
+    };
+
+    /*! Read a shard from a file.
+        \param path path of the file
+        \return The shard
+    */
+    static GridShard read(const std::string & path) {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) {
+            throw std::runtime_error("Cannot open the shard file " + path);
+        }
+        char file_magic[magic_size];
+        stream.read(file_magic, magic_size);
+        if (!stream || std::memcmp(file_magic, magic, magic_size) != 0 || read_value<std::int32_t>(stream, path) != version) {
+            throw std::runtime_error("The file " + path + " is not a grid shard (or has an unsupported version)");
+        }
+        const std::int32_t d = read_value<std::int32_t>(stream, path), grid_side = read_value<std::int32_t>(stream, path);
+        const std::int64_t n0 = read_value<std::int64_t>(stream, path), first = read_value<std::int64_t>(stream, path),
+                           count = read_value<std::int64_t>(stream, path);
+        const std::uint64_t fingerprint = read_value<std::uint64_t>(stream, path);
+        if (d < 1 || grid_side < 1 || n0 < 0 || first < 0 || count < 0) {
+            throw std::runtime_error("The shard file " + path + " is corrupted");
+        }
+
+        GridShard shard;
+        shard.start_point.resize(d);
+        shard.end_point.resize(d);
+        shard.grid_side = grid_side;
+        shard.first = first;
+        shard.p_values.resize(n0, count);
+        shard.fingerprint = fingerprint;
+        read_values(stream, shard.start_point.data(), d, path);
+        read_values(stream, shard.end_point.data(), d, path);
+        read_values(stream, shard.p_values.data(), n0 * count, path);
+        return shard;
+    };
+
+    private:
+    // Identifier at the beginning of the files (without the terminating null character)
+    static constexpr const char * magic = "CPCSHARD";
+    static const int magic_size = 8;
+    static const std::int32_t version = 2;
+
+    template<class T>
+    static void write_value(std::ofstream & stream, T value) {
+        stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    };
+
+    static void write_values(std::ofstream & stream, const double * values, std::int64_t count) {
+        stream.write(reinterpret_cast<const char *>(values), count * sizeof(double));
+    };
+
+    template<class T>
+    static T read_value(std::ifstream & stream, const std::string & path) {
+        T value;
+        if (!stream.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+            throw std::runtime_error("The shard file " + path + " is truncated");
+        }
+        return value;
+    };
+
+    static void read_values(std::ifstream & stream, double * values, std::int64_t count, const std::string & path) {
+        if (!stream.read(reinterpret_cast<char *>(values), count * sizeof(double))) {
+            throw std::runtime_error("The shard file " + path + " is truncated");
+        }
+    };
+};
+
+/*! Merge the shards of a grid into the p-values of the whole grid, as returned by @ref SingleGridAlgorithm::run.
+    The shards can be given in any order, but they must refer to the same grid and have the same fingerprint
+    (training data, `Xhat`, model and precision), and their ranges must cover the grid exactly once.
+    \param shards shards of the grid
+    \return The grid and the p-values of its points
+*/
+inline SingleGridResult merge_shards(std::vector<GridShard> shards) {
+    if (shards.empty()) {
+        throw std::invalid_argument("At least one shard is needed");
+    }
+    std::sort(shards.begin(), shards.end(), [](const GridShard & a, const GridShard & b) {
+        return a.first < b.first;
+    });
+    const GridShard & reference = shards.front();
+    SingleGridResult result = {Grid(reference.start_point, reference.end_point, reference.grid_side), MatrixXd()};
+    result.p_values.resize(reference.p_values.rows(), result.grid.get_size());
+
+    PointIndex next = 0;
+    for (const GridShard & shard : shards) {
+        if (shard.start_point != reference.start_point || shard.end_point != reference.end_point ||
+            shard.grid_side != reference.grid_side) {
+            throw std::invalid_argument("The shards must refer to the same grid");
+        }
+        if (shard.p_values.rows() != reference.p_values.rows()) {
+            throw std::invalid_argument("The shards must have the same number of Xhat");
+        }
+        if (shard.fingerprint != reference.fingerprint) {
+            throw std::invalid_argument("The shards must come from the same training data, Xhat, model and precision");
+        }
+        if (shard.first != next) {
+            throw std::invalid_argument("The shards must cover the grid exactly once (the point " +
+                                        std::to_string(std::min(shard.first, next)) +
+                                        (shard.first > next ? " is missing)" : " is repeated)"));
+        }
+        if (shard.p_values.cols() > result.grid.get_size() - next) {
+            throw std::invalid_argument("The shards must be inside of the grid");
+        }
+        result.p_values.middleCols(shard.first, shard.p_values.cols()) = shard.p_values;
+        next += shard.p_values.cols();
+    }
+    if (next != result.grid.get_size()) {
+        throw std::invalid_argument("The shards must cover the grid exactly once (the point " + std::to_string(next) + " is missing)");
+    }
+    return result;
+}
+
+#endif
@@ -1,20 +1,62 @@
 /*! @file */
 #ifndef __ALGORITHMS__SINGLE_GRID_HPP
 #define __ALGORITHMS__SINGLE_GRID_HPP
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include <omp.h>
-#include <random>
-#include <RcppEigen.h>
+#include <Eigen/Dense>
 #include "../grid.hpp"
+#include "../low_discrepancy.hpp"
+#include "../point_set.hpp"
 #include "base.hpp"
+#include "reducers.hpp"
+#include "residual_engines.hpp"
 
-using Rcpp::stop;
-using Rcpp::Named;
+/*! Result of a run of @ref SingleGridAlgorithm::run (or @ref SingleGridAlgorithm::run_on_points).
+    \param Points type of the set of points (@ref Grid, or e.g. @ref SobolSet)
+*/
+template<class Points>
+struct BasicSingleGridResult {
+    //! Grid used to sample the space of the covariates
+    Points grid;
+    //! p-values (one row for each `Xhat`, one column for each grid point)
+    MatrixXd p_values;
+};
+
+//! Result of a run of @ref SingleGridAlgorithm::run
+typedef BasicSingleGridResult<Grid> SingleGridResult;
+
+/*! Result of a run of @ref SingleGridAlgorithm::run_sparse.
+*/
+struct SparseGridResult {
+    //! Grid used to sample the space of the covariates
+    Grid grid;
+    //! Grid points with p-value greater or equal than alpha
+    SparsePValues kept;
+};
+
+/*! Result of a run of @ref SingleGridAlgorithm::run_membership.
+*/
+struct MembershipGridResult {
+    //! Grid used to sample the space of the covariates
+    Grid grid;
+    //! Grid points with p-value greater or equal than alpha, for each `Xhat`
+    std::vector<PointBitset> members;
+};
 
-/*! Implementation of a single-grid conformal algorithm
+/*! Implementation of a single-grid conformal algorithm.
+    The residuals are computed by the @ref ResidualEngine selected for the model:
+    linear and ridge regressions use the closed-form affine engine, models providing rank-one updates
+    (`fit_base` and `fit_update`) are updated with the tested point, other models are refitted at each grid point
+    (for a whole block of grid points at once, if they provide `fit_predict_batch`).
+    Models whose base factorisation is singular are also refitted (see @ref with_residual_engine).
 */
 template<class Model>
-class SingleGridAlgorithm : public AlgorithmBase<Model> {
+class SingleGridAlgorithm : public AlgorithmBase<Model, SingleGridResult> {
     public:
     /*! Construct a SingleGridAlgorithm instance
         \param grid_side number of points for each side of the grid
@@ -23,21 +65,155 @@ class SingleGridAlgorithm : public AlgorithmBase<Model> {
     SingleGridAlgorithm(int _grid_side, double _grid_param) :
         grid_side(_grid_side), grid_param(_grid_param) {};
     
-    /*! Run a conformal algorithm on a @ref Grid instance.
+    /*! Run a conformal algorithm on a @ref Grid instance (or any other @ref PointSet).
 
         \param model model to use as a base for conformal regression (will be copied at each run)
         \param X matrix of the independent variables
         \param Y matrix of the covariates
         \param Xhat a matrix containing multiple points to use as values for the independent variables
-        \param grid grid instance
-        \return An Rcpp list with the following members:
-        - `y_grid`: matrix with the coordinates of grid points in the space of the covariates
-        - `p_values`: p-values corresponding to those grid points
+        \param grid grid instance, or any other set of points
+        \return The p-values (one row for each `Xhat`, one column for each grid point)
     */
     virtual MatrixXd run_on_grid(
         const Model & initial_model,
-        const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat,
-        const Grid & grid
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const PointSet & grid
+    );
+
+    /*! Run a conformal algorithm on a @ref Grid instance (or any other @ref PointSet), with a model that has already been
+        prepared for the training data by `ResidualEngine<Model>::prepare_model` (e.g. factorised once and kept across calls,
+        see @ref ConformalPredictor). Nothing is fitted on the training data.
+
+        \param prepared_model model prepared for X and Y (will be copied by the engines)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grid grid instance, or any other set of points
+        \return The p-values (one row for each `Xhat`, one column for each grid point)
+    */
+    MatrixXd run_on_prepared_grid(
+        const Model & prepared_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const PointSet & grid
+    );
+
+    /*! Run a conformal algorithm using a different set of points for each `Xhat`.
+        All the (`Xhat`, point) pairs are evaluated in a single parallel loop.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grids a set of points for each row of `Xhat`
+        \return The p-values for each `Xhat` (one for each point of the corresponding set)
+    */
+    virtual std::vector<RowVectorXd> run_on_grids(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids
+    );
+
+    /*! Check which points of a set have a p-value greater or equal than alpha, for each `Xhat`, without computing the p-values.
+        Each block of points is first bounded by the box containing it: when the bounds of the scores over the box decide
+        the outcome for all of its points, they are not evaluated (models with affine residuals and split conformal only).
+        The other points are evaluated with `is_conforming`, which can stop counting the scores once the outcome is decided.
+        The result is the same as comparing the p-values of @ref SingleGridAlgorithm::run_on_grids with alpha.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grids a set of points for each row of `Xhat`
+        \param alpha minimum p-value of the points in the conformal region
+        \return The points in the conformal region, for each `Xhat`
+    */
+    virtual std::vector<PointBitset> run_membership_on_grids(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids, double alpha
+    );
+
+    /*! Run a conformal algorithm on a @ref PointSet one chunk at a time, passing the p-values of each chunk to a reducer,
+        so that the memory used does not depend on the size of the set.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grid grid instance, or any other set of points
+        \param chunk_size number of points in each chunk
+        \param reducer reducer consuming the p-values of each chunk
+    */
+    void run_on_grid_chunked(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const PointSet & grid, PointIndex chunk_size, GridReducer & reducer
+    );
+
+    /*! Run a conformal algorithm with a simple grid, evaluated one chunk at a time (see @ref SingleGridAlgorithm::run_on_grid_chunked).
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param chunk_size number of points in each chunk
+        \param reducer reducer consuming the p-values of each chunk
+        \return The grid (the result of the reduction is kept by the reducer)
+    */
+    Grid run_chunked(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        PointIndex chunk_size, GridReducer & reducer
+    );
+
+    /*! Run a conformal algorithm with a simple grid, returning only the grid points with p-value greater or equal than alpha,
+        without storing the p-values (or the coordinates) of the whole grid.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param alpha minimum p-value of the returned points
+        \return The grid and the kept points, in compressed sparse row format
+    */
+    SparseGridResult run_sparse(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        double alpha
+    );
+
+    /*! Run a conformal algorithm with a simple grid, returning only whether each grid point has p-value greater or equal than alpha
+        (see @ref SingleGridAlgorithm::run_membership_on_grids).
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param alpha minimum p-value of the points in the conformal region
+        \return The grid and the points in the conformal region, for each `Xhat`
+    */
+    MembershipGridResult run_membership(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        double alpha
+    );
+
+    /*! Run a conformal algorithm on a set of points of a given type, covering the same box as the grid of
+        @ref SingleGridAlgorithm::run, e.g. the points of a low-discrepancy sequence (@ref SobolSet or @ref HaltonSet),
+        whose number does not need to grow exponentially with d.
+
+        \param model model to use as a base for conformal regression (will be copied at each run)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param size number of points (passed to the constructor of Points, with the corners of the box)
+        \return The set of points and the p-values corresponding to its points
+    */
+    template<class Points>
+    BasicSingleGridResult<Points> run_on_points(
+        const Model & model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        PointIndex size
     );
 
     /*! Run a conformal algorithm with a simple grid,
@@ -47,15 +223,118 @@ class SingleGridAlgorithm : public AlgorithmBase<Model> {
         \param X matrix of the independent variables
         \param Y matrix of the covariates
         \param Xhat a matrix containing multiple points to use as values for the independent variables
-        \return An Rcpp list with the following members:
-        - `y_grid`: matrix with the coordinates of grid points in the space of the covariates
-        - `p_values`: p-values corresponding to those grid points
+        \return The grid and the p-values corresponding to its points
     */
-    List run(
+    SingleGridResult run(
         const Model & model,
-        const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat
     ) override;
 
+    protected:
+    /*! Check that the sizes of the data, of `Xhat` and of the sets of points are consistent.
+    */
+    static void check_dimensions(
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids
+    );
+
+    /*! Evaluate each (`Xhat` row, point of the corresponding set) pair, in a single parallel loop
+        over blocks of @ref SingleGridAlgorithm::evaluation_block_size points, generated with `PointSet::get_points`.
+        Each thread works on a copy of the engine, which is prepared again only when the `Xhat` row changes.
+        The loop uses the threading options of the algorithm (see @ref ParallelOptions), with a block as iteration.
+        The progress is reported to the monitor of the algorithm (see @ref ProgressMonitor): when it cancels
+        the evaluation, an @ref InterruptedError is thrown once every thread has stopped.
+        The time spent by each thread and the fits performed by the engines are added to the diagnostics.
+        \param prototype engine providing `set_xhat(xhat)` (see @ref ResidualEngineBase)
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grids a set of points for each row of `Xhat`
+        \param process function called for each block as `process(engine, row, first, points)`,
+            where `points` holds the coordinates of the points of the block (one row for each point, starting from `first`)
+        \param D number of covariates d, if known at compile time (see @ref dispatch_dimension), or `Dynamic`
+    */
+    template<int D, class Engine, class Process>
+    void evaluate(
+        const Engine & prototype, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids, Process process
+    );
+
+    /*! Compute the p-values of each (`Xhat` row, point of the corresponding set) pair (see @ref SingleGridAlgorithm::evaluate).
+        \param store function called as `store(row, point_idx, p_value)`
+    */
+    template<int D, class Engine, class Store>
+    void evaluate_p_values(
+        const Engine & prototype, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids, Store store
+    );
+
+    /*! Compute the p-values of the points of a block (see @ref SingleGridAlgorithm::evaluate_p_values),
+        at once if the engine provides `compute_p_values` (see @ref has_batch_p_values), and point by point otherwise.
+    */
+    template<int D, class Engine, class Points, class Store>
+    static void evaluate_p_values_block(
+        Engine & engine, int row, PointIndex first, const Points & points, double tie_breaking, Store & store, std::true_type
+    );
+
+    template<int D, class Engine, class Points, class Store>
+    static void evaluate_p_values_block(
+        Engine & engine, int row, PointIndex first, const Points & points, double tie_breaking, Store & store, std::false_type
+    );
+
+    /*! Compute the p-values on the same grid for each `Xhat` with an engine (see @ref SingleGridAlgorithm::evaluate).
+    */
+    template<int D, class Engine>
+    MatrixXd evaluate_on_grid(const Engine & prototype, const MatrixXd & Xhat, const PointSet & grid);
+
+    /*! Compute the p-values on a grid for each `Xhat` with an engine (see @ref SingleGridAlgorithm::evaluate).
+    */
+    template<int D, class Engine>
+    std::vector<RowVectorXd> evaluate_on_grids(
+        const Engine & prototype, const MatrixXd & Xhat, const std::vector<const PointSet *> & grids
+    );
+
+    /*! Check which points of a grid have a p-value greater or equal than alpha, for each `Xhat`, with an engine
+        (see @ref SingleGridAlgorithm::run_membership_on_grids and @ref SingleGridAlgorithm::evaluate).
+    */
+    template<int D, class Engine>
+    std::vector<PointBitset> evaluate_membership(
+        const Engine & prototype, const MatrixXd & Xhat, const std::vector<const PointSet *> & grids, double alpha
+    );
+
+    /*! Check which points of a block are in the conformal region (see @ref SingleGridAlgorithm::evaluate_membership).
+        The block is first classified with the bounds of the scores over its box, if the engine provides them:
+        when they do not decide the outcome, it is split in two halves (down to @ref SingleGridAlgorithm::min_bounded_points points),
+        since a block of consecutive grid points can span the whole grid along the first covariate.
+        \param points coordinates of the points of the block (one row for each point)
+        \param first index of the first point of the block
+        \param members bitset receiving the points in the conformal region
+        \return The number of points decided by the bounds
+    */
+    template<int D, class Engine>
+    static PointIndex evaluate_membership_block(
+        Engine & engine, const Ref<const Matrix<double, Dynamic, D>> & points, PointIndex first,
+        PointBitset & members, double tie_breaking, double alpha
+    );
+
+    //! Number of consecutive points generated at a time by @ref SingleGridAlgorithm::evaluate
+    static const PointIndex evaluation_block_size = 256;
+
+    //! Minimum number of points of the boxes bounded by @ref SingleGridAlgorithm::evaluate_membership_block
+    static const PointIndex min_bounded_points = 32;
+
+    //! Number of blocks for each thread between two polls of the progress monitor in @ref SingleGridAlgorithm::evaluate
+    static const PointIndex progress_round_blocks = 64;
+
+    //! Number of grid points evaluated at a time by @ref SingleGridAlgorithm::run_sparse
+    static const PointIndex sparse_chunk_size = 1 << 20;
+
+    /*! Build the grid used by @ref SingleGridAlgorithm::run and @ref SingleGridAlgorithm::run_chunked.
+    */
+    Grid make_grid(const DataView & Y) const;
+
+    /*! Get the end point of the box covered by the grid (the start point is its opposite).
+    */
+    VectorXd get_grid_limit(const DataView & Y) const;
+
     private:
     int grid_side;
     double grid_param;
@@ -63,83 +342,433 @@ class SingleGridAlgorithm : public AlgorithmBase<Model> {
 
 
 template<class Model>
-MatrixXd SingleGridAlgorithm<Model>::run_on_grid(
-    const Model & initial_model,
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat,
-    const Grid & grid
+void SingleGridAlgorithm<Model>::check_dimensions(
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids
 ) {
     if (X.cols() != Xhat.cols()) {
-        stop("X.cols() != Xhat.cols(), but they must be equal (to p)");
+        throw std::invalid_argument("X.cols() != Xhat.cols(), but they must be equal (to p)");
     }
     if (X.rows() != Y.rows()) {
-        stop("X.rows() != y.rows(), but they must be equal (to n)");
-    }
-
-    const int n = X.rows(), n0 = Xhat.rows(),
-              p = X.cols(), d = Y.cols(),
-              num_threads = omp_get_max_threads();
-    // Create a matrix containing the p-values
-    MatrixXd p_values = MatrixXd::Zero(n0, grid.get_size());
-    // Create a matrix and a vector for the regression model ("y = X \beta + \varepsilon"),
-    // adding (for each thread) a row which will contain the point Xhat and the corresponding y0 being tested.
-    // Its initial value does not really matter, it will be immediately overriden.
-    MatrixXd regression_matrix(n + num_threads, p);
-    MatrixXd regression_vector(n + num_threads, d);
-    regression_matrix << X, MatrixXd::Zero(num_threads, p);
-    regression_vector << Y, MatrixXd::Zero(num_threads, d);
-
-    std::default_random_engine generator;
-    std::uniform_real_distribution<double> uniform(0.0,1.0);
-    double tie_breaking = uniform(generator);
-
-    #pragma omp parallel
-    {
-        int this_thread = omp_get_thread_num();
-        SparseMatrix<double> reduction_matrix(n + 1, n + num_threads);
-        reduction_matrix.reserve(VectorXi::Ones(n + num_threads));
-        for (int i = 0; i < n; i++) {
-            reduction_matrix.insert(i, i) = 1;
+        throw std::invalid_argument("X.rows() != y.rows(), but they must be equal (to n)");
+    }
+    if (int(grids.size()) != Xhat.rows()) {
+        throw std::invalid_argument("A set of points is needed for each Xhat");
+    }
+    for (const PointSet * grid : grids) {
+        if (grid->get_dimension() != Y.cols()) {
+            throw std::invalid_argument("grid.get_dimension() != Y.cols(), but they must be equal (to d)");
         }
-        reduction_matrix.insert(n, n + this_thread) = 1;
-
-        #pragma omp for collapse(2)
-        for(int i = 0; i < n0; i++) {
-            for (int j = 0; j < grid.get_size(); j++) {
-                VectorXd y0 = grid.get_point(j);
-                regression_matrix.row(n + this_thread) = Xhat.row(i);
-                regression_vector.row(n + this_thread) = y0;
-
-                Model model(initial_model);
-                auto thread_regression_matrix = reduction_matrix * regression_matrix;
-                auto thread_regression_vector = reduction_matrix * regression_vector;
-                
-                model.fit(thread_regression_matrix, thread_regression_vector);
-                MatrixXd fitted_values = model.predict(thread_regression_matrix);
-                ArrayXd residuals = (thread_regression_vector - fitted_values).rowwise().norm().array();
-
-                p_values(i, j) = (
-                    (residuals > residuals(n)).count()
-                    + tie_breaking * (residuals == residuals(n)).count()
-                ) / (n+1.0);
+    }
+}
+
+
+template<class Model>
+template<int D, class Engine, class Process>
+void SingleGridAlgorithm<Model>::evaluate(
+    const Engine & prototype, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids, Process process
+) {
+    const int n0 = Xhat.rows();
+    if (n0 == 0) {
+        return;
+    }
+
+    // The points are evaluated in blocks of consecutive points of the same set, whose coordinates are generated together.
+    // The blocks are numbered row by row: row i owns the blocks from offsets[i] to offsets[i+1] - 1
+    const PointIndex block_size = evaluation_block_size;
+    std::vector<PointIndex> offsets(n0 + 1, 0);
+    for (int i = 0; i < n0; i++) {
+        offsets[i + 1] = offsets[i] + (grids[i]->get_size() + block_size - 1) / block_size;
+    }
+    const PointIndex total_blocks = offsets[n0];
+    const int d = grids[0]->get_dimension();
+    const double start_time = omp_get_wtime();
+    long long fits = 0, rechecks = 0;
+    const int num_threads = this->prepare_parallel_loop();
+    const ParallelScope scope(this->parallel_options);
+
+    // With a monitor, the blocks are split in rounds: between rounds, the master thread polls the monitor
+    // even if it has no block left in the round. Cancelled rounds skip their remaining blocks.
+    LoopProgress progress(this->progress_monitor, total_blocks);
+    const PointIndex round_blocks = this->progress_monitor ?
+        PointIndex(num_threads) * progress_round_blocks : std::max(total_blocks, PointIndex(1));
+
+    #pragma omp parallel num_threads(num_threads) reduction(+:fits, rechecks)
+    {
+        const double thread_start_time = omp_get_wtime();
+        Engine engine(prototype);
+        Matrix<double, Dynamic, D> points(block_size, d);
+        int current_row = -1;
+        double busy_seconds = omp_get_wtime() - thread_start_time;
+
+        for (PointIndex round_first = 0; round_first < total_blocks; round_first += round_blocks) {
+            const PointIndex round_last = std::min(round_first + round_blocks, total_blocks);
+            const double round_start_time = omp_get_wtime();
+
+            #pragma omp for schedule(runtime) nowait
+            for (PointIndex b = round_first; b < round_last; b++) {
+                if (progress.is_cancelled()) {
+                    continue;
+                }
+                if (current_row < 0 || b < offsets[current_row] || b >= offsets[current_row + 1]) {
+                    current_row = std::upper_bound(offsets.begin(), offsets.end(), b) - offsets.begin() - 1;
+                    engine.set_xhat(Xhat.row(current_row));
+                }
+
+                const PointIndex first = (b - offsets[current_row]) * block_size;
+                const PointIndex count = std::min(block_size, grids[current_row]->get_size() - first);
+                grids[current_row]->get_points(first, points.topRows(count));
+                process(engine, current_row, first, points.topRows(count));
+                progress.add_done(1);
+                progress.poll();
+            }
+
+            // The time spent waiting for the other threads is not counted
+            busy_seconds += omp_get_wtime() - round_start_time;
+            #pragma omp barrier
+            progress.poll();
+            #pragma omp barrier
+            if (progress.is_cancelled()) {
+                break;
             }
         }
+
+        fits += engine.get_fit_count();
+        rechecks += engine.get_recheck_count();
+        this->diagnostics.add_thread_time(busy_seconds);
+        #pragma omp master
+        this->diagnostics.threads = std::max(this->diagnostics.threads, omp_get_num_threads());
+    }
+
+    progress.poll(true);
+    progress.check();
+
+    this->diagnostics.evaluation_seconds += omp_get_wtime() - start_time;
+    this->diagnostics.model_fits += fits;
+    this->diagnostics.scores_rechecked += rechecks;
+    for (int i = 0; i < n0; i++) {
+        this->diagnostics.points_evaluated += grids[i]->get_size();
+    }
+}
+
+
+template<class Model>
+template<int D, class Engine, class Store>
+void SingleGridAlgorithm<Model>::evaluate_p_values(
+    const Engine & prototype, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids, Store store
+) {
+    const double tie_breaking = draw_tie_breaking();
+    evaluate<D>(prototype, Xhat, grids, [&](Engine & engine, int i, PointIndex first, const auto & points) {
+        evaluate_p_values_block<D>(engine, i, first, points, tie_breaking, store, has_batch_p_values<Engine>());
+    });
+}
+
+
+template<class Model>
+template<int D, class Engine, class Points, class Store>
+void SingleGridAlgorithm<Model>::evaluate_p_values_block(
+    Engine & engine, int row, PointIndex first, const Points & points, double tie_breaking, Store & store, std::true_type
+) {
+    Matrix<double, Dynamic, 1, ColMajor, evaluation_block_size, 1> p_values(points.rows());
+    engine.compute_p_values(points, tie_breaking, p_values);
+    for (PointIndex j = 0; j < points.rows(); j++) {
+        store(row, first + j, p_values(j));
+    }
+}
+
+
+template<class Model>
+template<int D, class Engine, class Points, class Store>
+void SingleGridAlgorithm<Model>::evaluate_p_values_block(
+    Engine & engine, int row, PointIndex first, const Points & points, double tie_breaking, Store & store, std::false_type
+) {
+    Matrix<double, D, 1> y0;
+    y0.resize(points.cols());
+    for (PointIndex j = 0; j < points.rows(); j++) {
+        y0 = points.row(j).transpose();
+        store(row, first + j, engine.compute_p_value(y0, tie_breaking));
     }
+}
+
+
+template<class Model>
+template<int D, class Engine>
+MatrixXd SingleGridAlgorithm<Model>::evaluate_on_grid(
+    const Engine & prototype, const MatrixXd & Xhat, const PointSet & grid
+) {
+    MatrixXd p_values(Xhat.rows(), grid.get_size());
+    const std::vector<const PointSet *> grids(Xhat.rows(), &grid);
+    evaluate_p_values<D>(prototype, Xhat, grids, [&p_values](int i, PointIndex j, double p_value) {
+        p_values(i, j) = p_value;
+    });
+    return p_values;
+}
 
+
+template<class Model>
+template<int D, class Engine>
+std::vector<RowVectorXd> SingleGridAlgorithm<Model>::evaluate_on_grids(
+    const Engine & prototype, const MatrixXd & Xhat, const std::vector<const PointSet *> & grids
+) {
+    std::vector<RowVectorXd> p_values(Xhat.rows());
+    for (int i = 0; i < Xhat.rows(); i++) {
+        p_values[i].resize(grids[i]->get_size());
+    }
+    evaluate_p_values<D>(prototype, Xhat, grids, [&p_values](int i, PointIndex j, double p_value) {
+        p_values[i](j) = p_value;
+    });
     return p_values;
 }
 
 
 template<class Model>
-List SingleGridAlgorithm<Model>::run(
+template<int D, class Engine>
+std::vector<PointBitset> SingleGridAlgorithm<Model>::evaluate_membership(
+    const Engine & prototype, const MatrixXd & Xhat, const std::vector<const PointSet *> & grids, double alpha
+) {
+    // The blocks start at multiples of the block size, so that each thread writes whole words of the bitsets
+    static_assert(evaluation_block_size % PointBitset::word_bits == 0, "The blocks must not share the words of the bitsets");
+    std::vector<PointBitset> members;
+    for (const PointSet * grid : grids) {
+        members.emplace_back(grid->get_size());
+    }
+
+    const double tie_breaking = draw_tie_breaking();
+    std::atomic<PointIndex> bounded(0);
+    evaluate<D>(prototype, Xhat, grids, [&](Engine & engine, int i, PointIndex first, const auto & points) {
+        bounded.fetch_add(evaluate_membership_block<D>(engine, points, first, members[i], tie_breaking, alpha), std::memory_order_relaxed);
+    });
+    this->diagnostics.points_bounded += bounded;
+    return members;
+}
+
+
+template<class Model>
+MatrixXd SingleGridAlgorithm<Model>::run_on_grid(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const PointSet & grid
+) {
+    const double start_time = omp_get_wtime();
+    check_dimensions(X, Y, Xhat, std::vector<const PointSet *>(Xhat.rows(), &grid));
+
+    // Work that does not depend on Xhat (e.g. factorising the training data) is done once, before copying the engine
+    Model model(initial_model);
+    ResidualEngine<Model>::prepare_model(model, X, Y);
+    this->diagnostics.model_fits += ResidualEngine<Model>::prepare_fits;
+    this->diagnostics.setup_seconds += omp_get_wtime() - start_time;
+
+    return run_on_prepared_grid(model, X, Y, Xhat, grid);
+}
+
+
+template<class Model>
+MatrixXd SingleGridAlgorithm<Model>::run_on_prepared_grid(
+    const Model & prepared_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const PointSet & grid
+) {
+    check_dimensions(X, Y, Xhat, std::vector<const PointSet *>(Xhat.rows(), &grid));
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return with_residual_engine<decltype(dimension)::value>(prepared_model, X, Y, [&](auto & prototype) {
+            prototype.set_precision(this->precision);
+            return this->template evaluate_on_grid<decltype(dimension)::value>(prototype, Xhat, grid);
+        });
+    });
+}
+
+
+template<class Model>
+std::vector<RowVectorXd> SingleGridAlgorithm<Model>::run_on_grids(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids
+) {
+    const double start_time = omp_get_wtime();
+    check_dimensions(X, Y, Xhat, grids);
+
+    Model model(initial_model);
+    ResidualEngine<Model>::prepare_model(model, X, Y);
+    this->diagnostics.model_fits += ResidualEngine<Model>::prepare_fits;
+    this->diagnostics.setup_seconds += omp_get_wtime() - start_time;
+
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return with_residual_engine<decltype(dimension)::value>(model, X, Y, [&](auto & prototype) {
+            prototype.set_precision(this->precision);
+            return this->template evaluate_on_grids<decltype(dimension)::value>(prototype, Xhat, grids);
+        });
+    });
+}
+
+
+template<class Model>
+template<int D, class Engine>
+PointIndex SingleGridAlgorithm<Model>::evaluate_membership_block(
+    Engine & engine, const Ref<const Matrix<double, Dynamic, D>> & points, PointIndex first,
+    PointBitset & members, double tie_breaking, double alpha
+) {
+    const Matrix<double, D, 1> lower = points.colwise().minCoeff().transpose(),
+                               upper = points.colwise().maxCoeff().transpose();
+    switch (classify_region(engine, lower, upper, tie_breaking, alpha, has_region_bounds<Engine>())) {
+        case RegionMembership::Inside:
+            members.set_range(first, points.rows());
+            return points.rows();
+        case RegionMembership::Outside:
+            return points.rows();
+        default:
+            break;
+    }
+
+    if (has_region_bounds<Engine>::value && points.rows() >= 2 * min_bounded_points) {
+        const PointIndex half = points.rows() / 2;
+        return evaluate_membership_block<D>(engine, points.topRows(half), first, members, tie_breaking, alpha)
+             + evaluate_membership_block<D>(engine, points.bottomRows(points.rows() - half), first + half, members, tie_breaking, alpha);
+    }
+
+    Matrix<double, D, 1> y0;
+    y0.resize(points.cols());
+    for (PointIndex j = 0; j < points.rows(); j++) {
+        y0 = points.row(j).transpose();
+        if (engine.is_conforming(y0, tie_breaking, alpha)) {
+            members.set(first + j);
+        }
+    }
+    return 0;
+}
+
+
+template<class Model>
+std::vector<PointBitset> SingleGridAlgorithm<Model>::run_membership_on_grids(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids, double alpha
+) {
+    const double start_time = omp_get_wtime();
+    check_dimensions(X, Y, Xhat, grids);
+
+    Model model(initial_model);
+    ResidualEngine<Model>::prepare_model(model, X, Y);
+    this->diagnostics.model_fits += ResidualEngine<Model>::prepare_fits;
+    this->diagnostics.setup_seconds += omp_get_wtime() - start_time;
+
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return with_residual_engine<decltype(dimension)::value>(model, X, Y, [&](auto & prototype) {
+            prototype.set_precision(this->precision);
+            return this->template evaluate_membership<decltype(dimension)::value>(prototype, Xhat, grids, alpha);
+        });
+    });
+}
+
+
+template<class Model>
+void SingleGridAlgorithm<Model>::run_on_grid_chunked(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const PointSet & grid, PointIndex chunk_size, GridReducer & reducer
+) {
+    if (chunk_size < 1) {
+        throw std::invalid_argument("chunk_size must be at least 1");
+    }
+
+    // Each chunk goes through run_on_grid, so that derived algorithms (e.g. split conformal) are chunked as well.
+    // The monitor receives the progress on the whole set
+    ProgressMonitor * const monitor = this->progress_monitor;
+    for (PointIndex first = 0; first < grid.get_size(); first += chunk_size) {
+        const PointRange chunk(grid, first, std::min(chunk_size, grid.get_size() - first));
+        if (monitor) {
+            PartialProgressMonitor chunk_monitor(*monitor, double(first) / grid.get_size(),
+                                                 double(chunk.get_size()) / grid.get_size());
+            this->progress_monitor = &chunk_monitor;
+            try {
+                reducer.consume(grid, first, run_on_grid(initial_model, X, Y, Xhat, chunk));
+            } catch (...) {
+                this->progress_monitor = monitor;
+                throw;
+            }
+            this->progress_monitor = monitor;
+        } else {
+            reducer.consume(grid, first, run_on_grid(initial_model, X, Y, Xhat, chunk));
+        }
+    }
+}
+
+
+template<class Model>
+Grid SingleGridAlgorithm<Model>::run_chunked(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    PointIndex chunk_size, GridReducer & reducer
+) {
+    this->reset_diagnostics();
+    const Grid grid = make_grid(Y);
+    run_on_grid_chunked(model, X, Y, Xhat, grid, chunk_size, reducer);
+    return grid;
+}
+
+
+template<class Model>
+SparseGridResult SingleGridAlgorithm<Model>::run_sparse(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    double alpha
+) {
+    this->reset_diagnostics();
+    const Grid grid = make_grid(Y);
+    ThresholdReducer reducer(alpha);
+    run_on_grid_chunked(model, X, Y, Xhat, grid, sparse_chunk_size, reducer);
+    return {grid, reducer.get_result()};
+}
+
+
+template<class Model>
+MembershipGridResult SingleGridAlgorithm<Model>::run_membership(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    double alpha
+) {
+    this->reset_diagnostics();
+    const Grid grid = make_grid(Y);
+    return {grid, run_membership_on_grids(model, X, Y, Xhat, std::vector<const PointSet *>(Xhat.rows(), &grid), alpha)};
+}
+
+
+template<class Model>
+Grid SingleGridAlgorithm<Model>::make_grid(const DataView & Y) const {
+    const VectorXd ylim = get_grid_limit(Y);
+    return Grid(-ylim, ylim, grid_side);
+}
+
+
+template<class Model>
+VectorXd SingleGridAlgorithm<Model>::get_grid_limit(const DataView & Y) const {
+    return grid_param * Y.array().abs().colwise().maxCoeff();
+}
+
+
+template<class Model>
+template<class Points>
+BasicSingleGridResult<Points> SingleGridAlgorithm<Model>::run_on_points(
     const Model & model,
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    PointIndex size
 ) {
-    const VectorXd ylim = grid_param * Y.array().abs().colwise().maxCoeff();
-    const Grid grid(-ylim, ylim, grid_side);
-    MatrixXd p_values = run_on_grid(model, X, Y, Xhat, grid);
+    this->reset_diagnostics();
+    const VectorXd ylim = get_grid_limit(Y);
+    const Points points(-ylim, ylim, size);
+    return {points, run_on_grid(model, X, Y, Xhat, points)};
+}
 
-    return List::create(Named("y_grid") = grid.collect(), 
-                        Named("p_values") = p_values);
+
+template<class Model>
+SingleGridResult SingleGridAlgorithm<Model>::run(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat
+) {
+    this->reset_diagnostics();
+    const Grid grid = make_grid(Y);
+    return {grid, run_on_grid(model, X, Y, Xhat, grid)};
 }
 
 #endif
@@ -0,0 +1,350 @@
+/*! @file */
+#ifndef __ALGORITHMS__SPLIT_HPP
+#define __ALGORITHMS__SPLIT_HPP
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include "../grid.hpp"
+#include "../point_set.hpp"
+#include "single_grid.hpp"
+
+/*! Detects whether a model can be fitted on data streamed in blocks of rows,
+    with `begin_base(p, d)`, `add_base_block(X_block, Y_block)` and `end_base()`.
+*/
+template<class Model, class = void>
+struct has_streaming_fit : std::false_type {};
+
+template<class Model>
+struct has_streaming_fit<Model, decltype(
+    std::declval<Model &>().begin_base(Index(), Index()),
+    std::declval<Model &>().add_base_block(std::declval<const MatrixXd &>(), std::declval<const MatrixXd &>()),
+    std::declval<Model &>().end_base(),
+void())> : std::true_type {};
+
+/*! Engine computing split conformal p-values, from a fitted model and the sorted calibration scores.
+    See @ref ResidualEngineBase for the interface.
+*/
+template<class Model>
+class SplitConformalEngine {
+    public:
+    /*! Construct an engine.
+        \param model model fitted on the training subset
+        \param scores sorted nonconformity scores of the calibration subset
+    */
+    SplitConformalEngine(const Model & _model, std::shared_ptr<const std::vector<double>> _scores) :
+        model(_model), scores(_scores) {};
+
+    /*! Set the values of the independent variables for the tested point, predicting the corresponding covariates.
+    */
+    void set_xhat(const RowVectorXd & xhat) {
+        prediction = model.predict(xhat).transpose();
+    };
+
+    /*! Compute the split conformal p-value of the tested point (xhat, y0), with a binary search.
+        \param y0 covariates of the tested point
+        \param tie_breaking weight given to ties between nonconformity scores
+        \return The p-value
+    */
+    template<class Vector>
+    double compute_p_value(const Vector & y0, double tie_breaking) {
+        // Squared norms are used as scores, since they preserve the ordering
+        const double score = (y0 - prediction).squaredNorm();
+        const auto equal_range = std::equal_range(scores->begin(), scores->end(), score);
+        const long greater = scores->end() - equal_range.second,
+                   equal = equal_range.second - equal_range.first;
+
+        // The tested point ties with itself
+        return conformal_p_value(greater, equal + 1, scores->size() + 1, tie_breaking);
+    };
+
+    /*! Check whether the tested point (xhat, y0) is inside the conformal region at level alpha.
+        See @ref ResidualEngineBase::is_conforming.
+    */
+    template<class Vector>
+    bool is_conforming(const Vector & y0, double tie_breaking, double alpha) {
+        return compute_p_value(y0, tie_breaking) >= alpha;
+    };
+
+    /*! Decide whether every point of a box of the covariates is inside (or outside) the conformal region at level alpha,
+        bounding the score of the tested point over the box (see @ref AffineResidualEngine::classify_region).
+    */
+    template<class Vector>
+    RegionMembership classify_region(const Vector & lower, const Vector & upper, double tie_breaking, double alpha) const {
+        double score_lower = 0, score_upper = 0;
+        for (Index k = 0; k < prediction.size(); k++) {
+            add_score_term_bounds(-prediction(k), 1.0, lower(k), upper(k), score_lower, score_upper);
+        }
+        const long greater = scores->end() - std::upper_bound(scores->begin(), scores->end(), score_upper),
+                   candidates = scores->end() - std::lower_bound(scores->begin(), scores->end(), score_lower);
+        return decide_region(greater, candidates, scores->size() + 1, tie_breaking, alpha);
+    };
+
+    /*! Get the number of model fits performed by this engine (none: the model is fitted once, before the evaluation).
+    */
+    long long get_fit_count() const {
+        return 0;
+    };
+
+    /*! Get the number of scores computed again in double precision (none: the scores are always computed in double precision).
+    */
+    long long get_recheck_count() const {
+        return 0;
+    };
+
+    private:
+    Model model;
+    std::shared_ptr<const std::vector<double>> scores;
+    VectorXd prediction;
+};
+
+/*! Implementation of a split (inductive) conformal algorithm.
+    The model is fitted once on a random training subset, and the nonconformity scores
+    of the remaining calibration points are kept sorted: the p-value of a grid point
+    then requires a single prediction and a binary search.
+    The observations are read @ref SplitConformalAlgorithm::stream_block_size rows at a time, without copying the subsets:
+    models with a streaming fit (see @ref has_streaming_fit) are fitted block by block,
+    the others on a copy of the training subset only.
+    Being a @ref SingleGridAlgorithm, it can also be used as the inner algorithm of a @ref MultiGridAlgorithm.
+    The fitted model and the calibration scores are kept by the instance, and reused by the following calls with the same
+    training data and model (e.g. for each level of a @ref MultiGridAlgorithm, or each chunk of
+    @ref SingleGridAlgorithm::run_chunked): the training data must not be modified in place between the runs of an instance.
+*/
+template<class Model>
+class SplitConformalAlgorithm : public SingleGridAlgorithm<Model> {
+    public:
+    /*! Construct a SplitConformalAlgorithm instance
+        \param grid_side number of points for each side of the grid
+        \param grid_param determines the size of the grid
+        \param train_fraction fraction of the observations used to fit the model (the others are used for calibration)
+        \param seed seed used to split the observations
+    */
+    SplitConformalAlgorithm(int _grid_side, double _grid_param, double _train_fraction, unsigned int _seed = 0) :
+        SingleGridAlgorithm<Model>(_grid_side, _grid_param),
+        train_fraction(_train_fraction), seed(_seed) {};
+
+    /*! Run a split conformal algorithm on a @ref Grid instance (or any other @ref PointSet).
+
+        \param model model to use as a base for conformal regression (will be copied and fitted once)
+        \param X matrix of the independent variables
+        \param Y matrix of the covariates
+        \param Xhat a matrix containing multiple points to use as values for the independent variables
+        \param grid grid instance, or any other set of points
+        \return The p-values (one row for each `Xhat`, one column for each grid point)
+    */
+    MatrixXd run_on_grid(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const PointSet & grid
+    ) override;
+
+    /*! Run a split conformal algorithm using a different set of points for each `Xhat`.
+        See @ref SingleGridAlgorithm::run_on_grids.
+    */
+    std::vector<RowVectorXd> run_on_grids(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids
+    ) override;
+
+    /*! Check which points of a set have a split conformal p-value greater or equal than alpha, for each `Xhat`.
+        See @ref SingleGridAlgorithm::run_membership_on_grids.
+    */
+    std::vector<PointBitset> run_membership_on_grids(
+        const Model & initial_model,
+        const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+        const std::vector<const PointSet *> & grids, double alpha
+    ) override;
+
+    //! Number of observations read at a time when fitting the model and computing the calibration scores
+    static const int stream_block_size = 4096;
+
+    private:
+    /*! Get the engine of the training data and model, fitting it with @ref SplitConformalAlgorithm::fit_split
+        only if the previous call was on different data or a different model.
+    */
+    const SplitConformalEngine<Model> & get_engine(const Model & initial_model, const DataView & X, const DataView & Y);
+
+    /*! Split the observations, fit the model on the training subset and compute the calibration scores.
+        \return An engine computing the p-values
+    */
+    SplitConformalEngine<Model> fit_split(const Model & initial_model, const DataView & X, const DataView & Y) const;
+
+    /*! Fit the model on the training subset (the first `n_train` observations of the permutation), streaming it in blocks.
+    */
+    static void fit_training(
+        Model & model, const DataView & X, const DataView & Y, const std::vector<int> & permutation, int n_train, std::true_type
+    );
+
+    /*! Fit the model on a copy of the training subset.
+    */
+    static void fit_training(
+        Model & model, const DataView & X, const DataView & Y, const std::vector<int> & permutation, int n_train, std::false_type
+    );
+
+    /*! Copy the observations of a range of the permutation.
+        \param first position of the first observation in the permutation
+        \param count number of observations
+        \param X_rows output matrix of the independent variables
+        \param Y_rows output matrix of the covariates
+    */
+    static void gather_rows(
+        const DataView & X, const DataView & Y, const std::vector<int> & permutation, int first, int count,
+        MatrixXd & X_rows, MatrixXd & Y_rows
+    );
+
+    double train_fraction;
+    unsigned int seed;
+
+    // Engine fitted by the last call to fit_split, with the model and data it was fitted on (addresses and shapes)
+    std::unique_ptr<SplitConformalEngine<Model>> fitted_engine;
+    const Model * fitted_model = nullptr;
+    const double * fitted_X = nullptr, * fitted_Y = nullptr;
+    std::vector<Index> fitted_shape;
+};
+
+
+template<class Model>
+const SplitConformalEngine<Model> & SplitConformalAlgorithm<Model>::get_engine(
+    const Model & initial_model, const DataView & X, const DataView & Y
+) {
+    const std::vector<Index> shape = {X.rows(), X.cols(), X.outerStride(), Y.rows(), Y.cols(), Y.outerStride()};
+    if (!fitted_engine || fitted_model != &initial_model || fitted_X != X.data() || fitted_Y != Y.data() ||
+        fitted_shape != shape) {
+        const double start_time = omp_get_wtime();
+        fitted_engine.reset(new SplitConformalEngine<Model>(fit_split(initial_model, X, Y)));
+        fitted_model = &initial_model;
+        fitted_X = X.data();
+        fitted_Y = Y.data();
+        fitted_shape = shape;
+        this->diagnostics.model_fits++;
+        this->diagnostics.setup_seconds += omp_get_wtime() - start_time;
+    }
+    return *fitted_engine;
+}
+
+
+template<class Model>
+SplitConformalEngine<Model> SplitConformalAlgorithm<Model>::fit_split(
+    const Model & initial_model, const DataView & X, const DataView & Y
+) const {
+    const int n = X.rows(),
+              n_train = std::round(train_fraction * n), n_calibration = n - n_train;
+    if (n_train <= 0 || n_calibration <= 0) {
+        throw std::invalid_argument("train_fraction must leave at least one observation for training and one for calibration");
+    }
+
+    std::vector<int> permutation(n);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::default_random_engine generator(seed);
+    std::shuffle(permutation.begin(), permutation.end(), generator);
+
+    Model model(initial_model);
+    fit_training(model, X, Y, permutation, n_train, has_streaming_fit<Model>());
+
+    // Squared norms are used as scores, since they preserve the ordering
+    auto scores = std::make_shared<std::vector<double>>(n_calibration);
+    MatrixXd X_block, Y_block;
+    for (int first = 0; first < n_calibration; first += stream_block_size) {
+        const int count = std::min(n_calibration - first, int(stream_block_size));
+        gather_rows(X, Y, permutation, n_train + first, count, X_block, Y_block);
+        const MatrixXd calibration_residuals = Y_block - model.predict(X_block);
+        for (int i = 0; i < count; i++) {
+            (*scores)[first + i] = calibration_residuals.row(i).squaredNorm();
+        }
+    }
+    std::sort(scores->begin(), scores->end());
+
+    return SplitConformalEngine<Model>(model, scores);
+}
+
+
+template<class Model>
+void SplitConformalAlgorithm<Model>::fit_training(
+    Model & model, const DataView & X, const DataView & Y, const std::vector<int> & permutation, int n_train, std::true_type
+) {
+    MatrixXd X_block, Y_block;
+    model.begin_base(X.cols(), Y.cols());
+    for (int first = 0; first < n_train; first += stream_block_size) {
+        gather_rows(X, Y, permutation, first, std::min(n_train - first, int(stream_block_size)), X_block, Y_block);
+        model.add_base_block(X_block, Y_block);
+    }
+    model.end_base();
+}
+
+
+template<class Model>
+void SplitConformalAlgorithm<Model>::fit_training(
+    Model & model, const DataView & X, const DataView & Y, const std::vector<int> & permutation, int n_train, std::false_type
+) {
+    MatrixXd X_train, Y_train;
+    gather_rows(X, Y, permutation, 0, n_train, X_train, Y_train);
+    model.fit(X_train, Y_train);
+}
+
+
+template<class Model>
+void SplitConformalAlgorithm<Model>::gather_rows(
+    const DataView & X, const DataView & Y, const std::vector<int> & permutation, int first, int count,
+    MatrixXd & X_rows, MatrixXd & Y_rows
+) {
+    X_rows.resize(count, X.cols());
+    Y_rows.resize(count, Y.cols());
+    for (int i = 0; i < count; i++) {
+        X_rows.row(i) = X.row(permutation[first + i]);
+        Y_rows.row(i) = Y.row(permutation[first + i]);
+    }
+}
+
+
+template<class Model>
+MatrixXd SplitConformalAlgorithm<Model>::run_on_grid(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const PointSet & grid
+) {
+    this->check_dimensions(X, Y, Xhat, std::vector<const PointSet *>(Xhat.rows(), &grid));
+    const SplitConformalEngine<Model> & engine = get_engine(initial_model, X, Y);
+
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return this->template evaluate_on_grid<decltype(dimension)::value>(engine, Xhat, grid);
+    });
+}
+
+
+template<class Model>
+std::vector<RowVectorXd> SplitConformalAlgorithm<Model>::run_on_grids(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids
+) {
+    this->check_dimensions(X, Y, Xhat, grids);
+    const SplitConformalEngine<Model> & engine = get_engine(initial_model, X, Y);
+
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return this->template evaluate_on_grids<decltype(dimension)::value>(engine, Xhat, grids);
+    });
+}
+
+template<class Model>
+std::vector<PointBitset> SplitConformalAlgorithm<Model>::run_membership_on_grids(
+    const Model & initial_model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const std::vector<const PointSet *> & grids, double alpha
+) {
+    this->check_dimensions(X, Y, Xhat, grids);
+    const SplitConformalEngine<Model> & engine = get_engine(initial_model, X, Y);
+
+    return dispatch_dimension(Y.cols(), [&](auto dimension) {
+        return this->template evaluate_membership<decltype(dimension)::value>(engine, Xhat, grids, alpha);
+    });
+}
+
+#endif
@@ -0,0 +1,15 @@
+/*! @file */
+#ifndef __DATA_VIEW_HPP
+#define __DATA_VIEW_HPP
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+/*! Read-only view of the training data (X or Y), taken by the algorithms and the residual engines.
+    It binds without copies to a `MatrixXd` as well as to a `Map` of memory owned elsewhere
+    (e.g. an R matrix, or a memory-mapped file), so that the memory footprint is set by the training data, not by their copies.
+    The viewed memory must outlive the run.
+*/
+typedef Ref<const MatrixXd> DataView;
+
+#endif
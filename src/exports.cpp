@@ -1,47 +1,865 @@
 #include "exports.hpp"
+#include <omp.h>
+#include "algorithms/adaptive_grid.hpp"
+#include "algorithms/exact_interval.hpp"
+#include "algorithms/level_sets.hpp"
 #include "algorithms/multi_grid.hpp"
+#include "algorithms/predictor.hpp"
+#include "algorithms/shards.hpp"
 #include "algorithms/single_grid.hpp"
+#include "algorithms/split.hpp"
+#include "lazy_points.hpp"
+#include "low_discrepancy.hpp"
+#include "models/kernel_ridge.hpp"
 #include "models/linear_regr.hpp"
 
+using Rcpp::Named;
+
+static std::unique_ptr<GridReducer> make_reducer(const std::string & reducer, double alpha, int n_bins) {
+    if (reducer == "threshold") {
+        return std::make_unique<ThresholdReducer>(alpha);
+    }
+    if (reducer == "histogram") {
+        return std::make_unique<HistogramReducer>(n_bins);
+    }
+    if (reducer == "bounding_box") {
+        return std::make_unique<BoundingBoxReducer>(alpha);
+    }
+    Rcpp::stop("Unknown reducer: %s (must be threshold, histogram or bounding_box)", reducer.c_str());
+}
+
+
+static ParallelOptions make_parallel_options(int num_threads, const std::string & schedule, int schedule_chunk_size) {
+    if (num_threads < 0 || schedule_chunk_size < 0) {
+        Rcpp::stop("num_threads and schedule_chunk_size must not be negative");
+    }
+    ParallelOptions options;
+    options.num_threads = num_threads;
+    options.schedule = parse_schedule(schedule);
+    options.chunk_size = schedule_chunk_size;
+    return options;
+}
+
+
+// R_CheckUserInterrupt jumps out of the calling function when the user has interrupted the computation:
+// it is called through R_ToplevelExec, which returns FALSE instead.
+static void check_user_interrupt(void *) {
+    R_CheckUserInterrupt();
+}
+
+
+/*! Monitor cancelling the evaluation when the user interrupts the computation in R.
+*/
+class RProgressMonitor : public ProgressMonitor {
+    public:
+    /*! Construct a RProgressMonitor instance
+        \param print_progress print the fraction of each evaluation completed
+    */
+    RProgressMonitor(bool _print_progress = false) : print_progress(_print_progress) {};
+
+    bool update(double fraction) override {
+        if (print_progress) {
+            Rcpp::Rcout << "\rEvaluated " << int(100 * fraction) << "% of the points" << (fraction >= 1 ? "\n" : "");
+            Rcpp::Rcout.flush();
+        }
+        return !R_ToplevelExec(check_user_interrupt, nullptr);
+    };
+
+    private:
+    bool print_progress;
+};
+
+
+template<class Algorithm>
+static void configure(
+    Algorithm & algorithm, ProgressMonitor & monitor,
+    int num_threads, const std::string & schedule, int schedule_chunk_size, const std::string & precision = "double"
+) {
+    algorithm.set_parallel_options(make_parallel_options(num_threads, schedule, schedule_chunk_size));
+    algorithm.set_precision(parse_precision(precision));
+    algorithm.set_progress_monitor(&monitor);
+}
+
+
+// Conversion of the results to R lists.
+// Point indices are returned as doubles starting from 1, since R integers have only 32 bits.
+
+static VectorXd to_r_indices(const std::vector<PointIndex> & indices) {
+    VectorXd r_indices(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        r_indices(i) = indices[i] + 1;
+    }
+    return r_indices;
+}
+
+
+static List to_list(const Grid & grid) {
+    return List::create(Named("start_point") = grid.get_start_point(),
+                        Named("end_point") = grid.get_end_point(),
+                        Named("grid_side") = grid.get_grid_side());
+}
+
+
+template<class Sequence>
+static List to_list(const LowDiscrepancySet<Sequence> & points) {
+    return List::create(Named("start_point") = points.get_start_point(),
+                        Named("end_point") = points.get_end_point(),
+                        Named("n_points") = double(points.get_size()),
+                        Named("sequence") = std::string(Sequence::get_name()));
+}
+
+
+static List to_list(const SparsePValues & kept) {
+    VectorXd row_pointers(kept.row_pointers.size());
+    for (size_t i = 0; i < kept.row_pointers.size(); i++) {
+        row_pointers(i) = kept.row_pointers[i];
+    }
+    return List::create(Named("row_pointers") = row_pointers,
+                        Named("indices") = to_r_indices(kept.indices),
+                        Named("p_values") = VectorXd(Map<const VectorXd>(kept.p_values.data(), kept.p_values.size())));
+}
+
+
+static List to_list(const GridReducer & reducer) {
+    if (const ThresholdReducer * threshold = dynamic_cast<const ThresholdReducer *>(&reducer)) {
+        return to_list(threshold->get_result());
+    }
+    if (const HistogramReducer * histogram = dynamic_cast<const HistogramReducer *>(&reducer)) {
+        return List::create(Named("breaks") = histogram->get_breaks(),
+                            Named("counts") = histogram->get_counts());
+    }
+    const BoundingBoxReducer & box = dynamic_cast<const BoundingBoxReducer &>(reducer);
+    return List::create(Named("start_point") = box.get_start_points(),
+                        Named("end_point") = box.get_end_points(),
+                        Named("count") = box.get_counts());
+}
+
+
+template<class Points>
+static List to_list(const BasicSingleGridResult<Points> & result) {
+    return List::create(Named("y_grid") = LazyPointMatrix::create(result.grid),
+                        Named("p_values") = result.p_values);
+}
+
+
+static List to_list(const SparseGridResult & result) {
+    const List kept = to_list(result.kept);
+    return List::create(Named("y_grid_parameters") = to_list(result.grid),
+                        Named("row_pointers") = kept["row_pointers"],
+                        Named("indices") = kept["indices"],
+                        Named("p_values") = kept["p_values"]);
+}
+
+
+// The bits are packed from the least significant one, as expected by rawToBits
+static Rcpp::RawVector to_raw(const PointBitset & members) {
+    Rcpp::RawVector raw((members.get_size() + 7) / 8);
+    const std::vector<std::uint64_t> & words = members.get_words();
+    for (R_xlen_t i = 0; i < raw.size(); i++) {
+        raw[i] = (words[i / 8] >> (8 * (i % 8))) & 0xff;
+    }
+    return raw;
+}
+
+
+static List to_list(const MembershipGridResult & result) {
+    List members(result.members.size());
+    for (size_t i = 0; i < result.members.size(); i++) {
+        members[i] = to_raw(result.members[i]);
+    }
+    return List::create(Named("y_grid_parameters") = to_list(result.grid),
+                        Named("members") = members);
+}
+
+
+template<class Points>
+static List to_list(const BasicMultiGridResult<Points> & result) {
+    const size_t n0 = result.grids.size();
+    List y_grids(n0);
+    std::vector<List> grid_parameters;
+    for (size_t j = 0; j < n0; j++) {
+        std::vector<List> history;
+        for (const Points & grid : result.grids[j]) {
+            history.push_back(to_list(grid));
+        }
+        y_grids[j] = LazyPointMatrix::create(result.grids[j].back());
+        grid_parameters.push_back(List(Rcpp::wrap(history)));
+    }
+
+    // With a single Xhat, the members are not wrapped in lists
+    if (n0 == 1) {
+        return List::create(Named("y_grid") = y_grids[0],
+                            Named("y_grid_parameters") = grid_parameters[0],
+                            Named("p_values") = result.p_values[0]);
+    }
+    return List::create(Named("y_grid") = y_grids,
+                        Named("y_grid_parameters") = grid_parameters,
+                        Named("p_values") = result.p_values);
+}
+
+
+static List to_list(const AdaptiveGridResult & result) {
+    return List::create(Named("y_grid") = result.y_grid,
+                        Named("p_values") = result.p_values,
+                        Named("cells") = result.cells,
+                        Named("cell_size") = result.cell_size,
+                        Named("y_grid_parameters") = to_list(result.initial_grid));
+}
+
+
+static List to_list(const std::vector<ExactConformalRegion> & regions) {
+    std::vector<List> regions_list;
+    for (const ExactConformalRegion & region : regions) {
+        regions_list.push_back(List::create(Named("breakpoints") = region.breakpoints,
+                                            Named("p_values") = region.p_values,
+                                            Named("breakpoint_p_values") = region.breakpoint_p_values,
+                                            Named("intervals") = region.intervals));
+    }
+    return List::create(Named("regions") = regions_list);
+}
+
+
+static List to_list(const LevelSet & level_set) {
+    List result = List::create(Named("alpha") = level_set.alpha,
+                               Named("count") = double(level_set.count),
+                               Named("start_point") = level_set.start_point,
+                               Named("end_point") = level_set.end_point);
+    if (level_set.start_point.size() == 2) {
+        List contours(level_set.contours.size());
+        for (size_t c = 0; c < level_set.contours.size(); c++) {
+            contours[c] = level_set.contours[c];
+        }
+        result.push_back(contours, "contours");
+        result.push_back(level_set.closed, "closed");
+    } else {
+        result.push_back(to_r_indices(level_set.boundary_cells), "boundary_cells");
+    }
+    return result;
+}
+
+
+static List to_list(const std::vector<std::vector<LevelSet>> & level_sets) {
+    List result(level_sets.size());
+    for (size_t i = 0; i < level_sets.size(); i++) {
+        List sets(level_sets[i].size());
+        for (size_t a = 0; a < level_sets[i].size(); a++) {
+            sets[a] = to_list(level_sets[i][a]);
+        }
+        result[i] = sets;
+    }
+    return result;
+}
+
+
+static List to_list(const RunDiagnostics & diagnostics) {
+    return List::create(Named("setup_seconds") = diagnostics.setup_seconds,
+                        Named("evaluation_seconds") = diagnostics.evaluation_seconds,
+                        Named("refinement_seconds") = diagnostics.refinement_seconds,
+                        Named("marshalling_seconds") = diagnostics.marshalling_seconds,
+                        Named("points_evaluated") = double(diagnostics.points_evaluated),
+                        Named("points_bounded") = double(diagnostics.points_bounded),
+                        Named("scores_rechecked") = double(diagnostics.scores_rechecked),
+                        Named("model_fits") = double(diagnostics.model_fits),
+                        Named("threads") = diagnostics.threads,
+                        Named("schedule") = diagnostics.schedule,
+                        Named("schedule_chunk_size") = diagnostics.schedule_chunk_size,
+                        Named("thread_seconds") = diagnostics.thread_seconds,
+                        Named("load_imbalance") = diagnostics.get_load_imbalance());
+}
+
+
+// The time spent converting the result is measured from marshalling_start_time
+static void attach_diagnostics(List & result, RunDiagnostics diagnostics, double marshalling_start_time) {
+    diagnostics.marshalling_seconds = omp_get_wtime() - marshalling_start_time;
+    result.push_back(to_list(diagnostics), "diagnostics");
+}
+
+
+template<class Result, class Algorithm>
+static List to_list(const Result & result, const Algorithm & algorithm, bool diagnostics) {
+    const double start_time = omp_get_wtime();
+    List list = to_list(result);
+    if (diagnostics) {
+        attach_diagnostics(list, algorithm.get_diagnostics(), start_time);
+    }
+    return list;
+}
+
+
 List run_linear_conformal_single_grid(
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat,
-    int grid_side, double grid_param
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
 ) {
     LinearRegression model;
     SingleGridAlgorithm<LinearRegression> algorithm(grid_side, grid_param);
-    return algorithm.run(model, X, Y, Xhat);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
 }
 
 
 List run_ridge_conformal_single_grid(
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat,
-    double lambda, int grid_side, double grid_param
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
 ) {
     RidgeRegression model(lambda);
     SingleGridAlgorithm<RidgeRegression> algorithm(grid_side, grid_param);
-    return algorithm.run(model, X, Y, Xhat);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
 }
 
 
 List run_linear_conformal_multi_grid(
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat,
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
     const VectorXd & grid_levels, const VectorXd & grid_sides, double initial_grid_param,
-    bool print_progress
+    bool print_progress,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
 ) {
     LinearRegression model;
     auto inner_algorithm = std::make_unique<SingleGridAlgorithm<LinearRegression>>(grid_sides[0], initial_grid_param);
     MultiGridAlgorithm<LinearRegression> algorithm(grid_levels, grid_sides, initial_grid_param, std::move(inner_algorithm), print_progress);
-    return algorithm.run(model, X, Y, Xhat);
+    RProgressMonitor monitor(print_progress);
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
 }
 
 
 List run_ridge_conformal_multi_grid(
-    const MatrixXd & X, const MatrixXd & Y, const MatrixXd & Xhat, double lambda,
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat, double lambda,
     const VectorXd & grid_levels, const VectorXd & grid_sides, double initial_grid_param,
-    bool print_progress
+    bool print_progress,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
 ) {
     RidgeRegression model(lambda);
     auto inner_algorithm = std::make_unique<SingleGridAlgorithm<RidgeRegression>>(grid_sides[0], initial_grid_param);
     MultiGridAlgorithm<RidgeRegression> algorithm(grid_levels, grid_sides, initial_grid_param, std::move(inner_algorithm), print_progress);
-    return algorithm.run(model, X, Y, Xhat);
+    RProgressMonitor monitor(print_progress);
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+// The kernels are selected at runtime by their name: the function receives the model
+template<class Function>
+static List with_kernel_model(
+    const std::string & kernel, double lambda, int n_landmarks,
+    double gamma, int degree, double coef0, unsigned int seed, Function function
+) {
+    if (kernel == "gaussian") {
+        return function(GaussianKernelRidge(GaussianKernel(gamma), lambda, n_landmarks, seed));
+    }
+    if (kernel == "polynomial") {
+        return function(PolynomialKernelRidge(PolynomialKernel(degree, gamma, coef0), lambda, n_landmarks, seed));
+    }
+    Rcpp::stop("Unknown kernel: %s (must be gaussian or polynomial)", kernel.c_str());
+}
+
+
+List run_kernel_conformal_single_grid(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    std::string kernel, double lambda, int n_landmarks,
+    double gamma, int degree, double coef0, unsigned int seed,
+    int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return with_kernel_model(kernel, lambda, n_landmarks, gamma, degree, coef0, seed, [&](const auto & model) {
+        typedef typename std::decay<decltype(model)>::type Model;
+        SingleGridAlgorithm<Model> algorithm(grid_side, grid_param);
+        RProgressMonitor monitor;
+        configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+        return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+    });
+}
+
+
+List run_kernel_conformal_multi_grid(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & grid_levels, const VectorXd & grid_sides, double initial_grid_param,
+    std::string kernel, double lambda, int n_landmarks,
+    double gamma, int degree, double coef0, unsigned int seed,
+    bool print_progress,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return with_kernel_model(kernel, lambda, n_landmarks, gamma, degree, coef0, seed, [&](const auto & model) {
+        typedef typename std::decay<decltype(model)>::type Model;
+        auto inner_algorithm = std::make_unique<SingleGridAlgorithm<Model>>(grid_sides[0], initial_grid_param);
+        MultiGridAlgorithm<Model> algorithm(grid_levels, grid_sides, initial_grid_param, std::move(inner_algorithm), print_progress);
+        RProgressMonitor monitor(print_progress);
+        configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+        return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+    });
+}
+
+
+// The low-discrepancy sets are selected at runtime by the name of their sequence
+template<class Model>
+static List run_qmc(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    double n_points, const std::string & sequence, double grid_param,
+    int num_threads, const std::string & schedule, int schedule_chunk_size, bool diagnostics
+) {
+    SingleGridAlgorithm<Model> algorithm(0, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    if (sequence == "sobol") {
+        return to_list(algorithm.template run_on_points<SobolSet>(model, X, Y, Xhat, n_points), algorithm, diagnostics);
+    }
+    if (sequence == "halton") {
+        return to_list(algorithm.template run_on_points<HaltonSet>(model, X, Y, Xhat, n_points), algorithm, diagnostics);
+    }
+    Rcpp::stop("Unknown sequence: %s (must be sobol or halton)", sequence.c_str());
+}
+
+
+template<class Points, class Model>
+static List run_multi_qmc(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const VectorXd & grid_levels, const VectorXd & n_points, double initial_grid_param,
+    bool print_progress,
+    int num_threads, const std::string & schedule, int schedule_chunk_size, bool diagnostics
+) {
+    auto inner_algorithm = std::make_unique<SingleGridAlgorithm<Model>>(0, initial_grid_param);
+    MultiGridAlgorithm<Model, Points> algorithm(grid_levels, n_points, initial_grid_param, std::move(inner_algorithm), print_progress);
+    RProgressMonitor monitor(print_progress);
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+template<class Model>
+static List run_multi_qmc(
+    const Model & model,
+    const DataView & X, const DataView & Y, const MatrixXd & Xhat,
+    const VectorXd & grid_levels, const VectorXd & n_points, double initial_grid_param,
+    const std::string & sequence, bool print_progress,
+    int num_threads, const std::string & schedule, int schedule_chunk_size, bool diagnostics
+) {
+    if (sequence == "sobol") {
+        return run_multi_qmc<SobolSet>(model, X, Y, Xhat, grid_levels, n_points, initial_grid_param, print_progress,
+                                       num_threads, schedule, schedule_chunk_size, diagnostics);
+    }
+    if (sequence == "halton") {
+        return run_multi_qmc<HaltonSet>(model, X, Y, Xhat, grid_levels, n_points, initial_grid_param, print_progress,
+                                        num_threads, schedule, schedule_chunk_size, diagnostics);
+    }
+    Rcpp::stop("Unknown sequence: %s (must be sobol or halton)", sequence.c_str());
+}
+
+
+List run_linear_conformal_qmc(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double n_points, std::string sequence, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_qmc(LinearRegression(), X, Y, Xhat, n_points, sequence, grid_param,
+                   num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_ridge_conformal_qmc(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, double n_points, std::string sequence, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_qmc(RidgeRegression(lambda), X, Y, Xhat, n_points, sequence, grid_param,
+                   num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_linear_conformal_multi_qmc(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & grid_levels, const VectorXd & n_points, double initial_grid_param,
+    std::string sequence, bool print_progress,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_multi_qmc(LinearRegression(), X, Y, Xhat, grid_levels, n_points, initial_grid_param, sequence, print_progress,
+                         num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_ridge_conformal_multi_qmc(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat, double lambda,
+    const VectorXd & grid_levels, const VectorXd & n_points, double initial_grid_param,
+    std::string sequence, bool print_progress,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_multi_qmc(RidgeRegression(lambda), X, Y, Xhat, grid_levels, n_points, initial_grid_param, sequence, print_progress,
+                         num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_linear_conformal_exact(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double alpha,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    ExactIntervalAlgorithm<LinearRegression> algorithm(alpha);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_ridge_conformal_exact(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, double alpha,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    ExactIntervalAlgorithm<RidgeRegression> algorithm(alpha);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_linear_conformal_split(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double train_fraction, int grid_side, double grid_param, int seed,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    SplitConformalAlgorithm<LinearRegression> algorithm(grid_side, grid_param, train_fraction, seed);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_ridge_conformal_split(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, double train_fraction, int grid_side, double grid_param, int seed,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    SplitConformalAlgorithm<RidgeRegression> algorithm(grid_side, grid_param, train_fraction, seed);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_linear_conformal_adaptive_grid(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & grid_levels, int initial_grid_side, double initial_grid_param,
+    bool print_progress,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    auto inner_algorithm = std::make_unique<SingleGridAlgorithm<LinearRegression>>(initial_grid_side, initial_grid_param);
+    AdaptiveGridAlgorithm<LinearRegression> algorithm(grid_levels, initial_grid_side, initial_grid_param, std::move(inner_algorithm), print_progress);
+    RProgressMonitor monitor(print_progress);
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_ridge_conformal_adaptive_grid(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat, double lambda,
+    const VectorXd & grid_levels, int initial_grid_side, double initial_grid_param,
+    bool print_progress,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    auto inner_algorithm = std::make_unique<SingleGridAlgorithm<RidgeRegression>>(initial_grid_side, initial_grid_param);
+    AdaptiveGridAlgorithm<RidgeRegression> algorithm(grid_levels, initial_grid_side, initial_grid_param, std::move(inner_algorithm), print_progress);
+    RProgressMonitor monitor(print_progress);
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run(model, X, Y, Xhat), algorithm, diagnostics);
+}
+
+
+List run_linear_conformal_sparse(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double alpha, int grid_side, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    SingleGridAlgorithm<LinearRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run_sparse(model, X, Y, Xhat, alpha), algorithm, diagnostics);
+}
+
+
+List run_ridge_conformal_sparse(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, double alpha, int grid_side, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    SingleGridAlgorithm<RidgeRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run_sparse(model, X, Y, Xhat, alpha), algorithm, diagnostics);
+}
+
+
+List run_linear_conformal_membership(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double alpha, int grid_side, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    SingleGridAlgorithm<LinearRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run_membership(model, X, Y, Xhat, alpha), algorithm, diagnostics);
+}
+
+
+List run_ridge_conformal_membership(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, double alpha, int grid_side, double grid_param,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    SingleGridAlgorithm<RidgeRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    return to_list(algorithm.run_membership(model, X, Y, Xhat, alpha), algorithm, diagnostics);
+}
+
+
+MatrixXd get_grid_points(
+    const VectorXd & start_point, const VectorXd & end_point, int grid_side,
+    const VectorXd & indices
+) {
+    const Grid grid(start_point, end_point, grid_side);
+    std::vector<PointIndex> point_indices(indices.size());
+    for (int i = 0; i < indices.size(); i++) {
+        if (indices(i) < 1 || indices(i) > grid.get_size()) {
+            Rcpp::stop("Grid point index out of range: %f", indices(i));
+        }
+        point_indices[i] = PointIndex(indices(i)) - 1;
+    }
+    return grid.collect(point_indices);
+}
+
+
+List run_linear_conformal_chunked(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    std::string reducer, double alpha, int n_bins,
+    int grid_side, double grid_param, double chunk_size,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    LinearRegression model;
+    SingleGridAlgorithm<LinearRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    const std::unique_ptr<GridReducer> grid_reducer = make_reducer(reducer, alpha, n_bins);
+    const Grid grid = algorithm.run_chunked(model, X, Y, Xhat, chunk_size, *grid_reducer);
+
+    const double start_time = omp_get_wtime();
+    List result = List::create(Named("y_grid_parameters") = to_list(grid),
+                               Named("reduction") = to_list(*grid_reducer));
+    if (diagnostics) {
+        attach_diagnostics(result, algorithm.get_diagnostics(), start_time);
+    }
+    return result;
+}
+
+
+List run_ridge_conformal_chunked(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat, double lambda,
+    std::string reducer, double alpha, int n_bins,
+    int grid_side, double grid_param, double chunk_size,
+    int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RidgeRegression model(lambda);
+    SingleGridAlgorithm<RidgeRegression> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size);
+    const std::unique_ptr<GridReducer> grid_reducer = make_reducer(reducer, alpha, n_bins);
+    const Grid grid = algorithm.run_chunked(model, X, Y, Xhat, chunk_size, *grid_reducer);
+
+    const double start_time = omp_get_wtime();
+    List result = List::create(Named("y_grid_parameters") = to_list(grid),
+                               Named("reduction") = to_list(*grid_reducer));
+    if (diagnostics) {
+        attach_diagnostics(result, algorithm.get_diagnostics(), start_time);
+    }
+    return result;
+}
+
+
+// The p-values are reduced to their level sets as soon as they are computed, so that only the boundaries are converted
+template<class Model>
+static List run_level_sets(
+    const Model & model, const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & alphas, int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    SingleGridAlgorithm<Model> algorithm(grid_side, grid_param);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    const SingleGridResult grid_result = algorithm.run(model, X, Y, Xhat);
+
+    const double start_time = omp_get_wtime();
+    LevelSetExtractor extractor(alphas);
+    extractor.set_parallel_options(make_parallel_options(num_threads, schedule, schedule_chunk_size));
+    List result = List::create(Named("y_grid_parameters") = to_list(grid_result.grid),
+                               Named("level_sets") = to_list(extractor.extract(grid_result.grid, grid_result.p_values)));
+    if (diagnostics) {
+        attach_diagnostics(result, algorithm.get_diagnostics(), start_time);
+    }
+    return result;
+}
+
+
+List run_linear_conformal_level_sets(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & alphas, int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_level_sets(LinearRegression(), X, Y, Xhat, alphas, grid_side, grid_param,
+                          precision, num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_ridge_conformal_level_sets(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    double lambda, const VectorXd & alphas, int grid_side, double grid_param,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    return run_level_sets(RidgeRegression(lambda), X, Y, Xhat, alphas, grid_side, grid_param,
+                          precision, num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+Rcpp::XPtr<ConformalPredictorBase> new_linear_conformal_predictor(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y,
+    int grid_side, double grid_param
+) {
+    return Rcpp::XPtr<ConformalPredictorBase>(
+        new ConformalPredictor<LinearRegression>(LinearRegression(), X, Y, grid_side, grid_param), true
+    );
+}
+
+
+Rcpp::XPtr<ConformalPredictorBase> new_ridge_conformal_predictor(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, double lambda,
+    int grid_side, double grid_param
+) {
+    return Rcpp::XPtr<ConformalPredictorBase>(
+        new ConformalPredictor<RidgeRegression>(RidgeRegression(lambda), X, Y, grid_side, grid_param), true
+    );
+}
+
+
+List predict_region(
+    Rcpp::XPtr<ConformalPredictorBase> predictor, const MatrixXd & Xhat,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    RProgressMonitor monitor;
+    configure(*predictor, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    const SingleGridResult result = predictor->predict_region(Xhat);
+
+    // The grid is returned by its parameters, since it does not change between queries
+    const double start_time = omp_get_wtime();
+    List list = List::create(Named("y_grid_parameters") = to_list(result.grid),
+                             Named("p_values") = result.p_values);
+    if (diagnostics) {
+        attach_diagnostics(list, predictor->get_diagnostics(), start_time);
+    }
+    return list;
+}
+
+
+int add_observations(
+    Rcpp::XPtr<ConformalPredictorBase> predictor, const MatrixXd & X_new, const MatrixXd & Y_new
+) {
+    predictor->add_observations(X_new, Y_new);
+    return predictor->get_size();
+}
+
+
+template<class Model>
+static List run_shard(
+    const Model & model, const ShardFingerprint & fingerprint,
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & start_point, const VectorXd & end_point, int grid_side,
+    double first, double count, const std::string & path,
+    const std::string & precision, int num_threads, const std::string & schedule, int schedule_chunk_size, bool diagnostics
+) {
+    const Grid grid(start_point, end_point, grid_side);
+    if (first < 1 || count < 1 || first + count - 1 > grid.get_size()) {
+        Rcpp::stop("The range of a shard must contain at least one point, and be inside of the grid");
+    }
+    SingleGridAlgorithm<Model> algorithm(grid_side, 0);
+    RProgressMonitor monitor;
+    configure(algorithm, monitor, num_threads, schedule, schedule_chunk_size, precision);
+    const GridShard shard = evaluate_grid_shard(algorithm, model, fingerprint, X, Y, Xhat, grid,
+                                                PointIndex(first) - 1, PointIndex(count));
+
+    const double start_time = omp_get_wtime();
+    GridShardFile::write(shard, path);
+    List result = List::create(Named("path") = path,
+                               Named("first") = first,
+                               Named("count") = count);
+    if (diagnostics) {
+        attach_diagnostics(result, algorithm.get_diagnostics(), start_time);
+    }
+    return result;
+}
+
+
+List run_linear_conformal_shard(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat,
+    const VectorXd & start_point, const VectorXd & end_point, int grid_side,
+    double first, double count, std::string path,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    // A linear regression is a ridge regression without penalty
+    ShardFingerprint fingerprint;
+    fingerprint.add(0.0);
+    return run_shard(LinearRegression(), fingerprint, X, Y, Xhat, start_point, end_point, grid_side, first, count, path,
+                     precision, num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List run_ridge_conformal_shard(
+    const Map<MatrixXd> & X, const Map<MatrixXd> & Y, const MatrixXd & Xhat, double lambda,
+    const VectorXd & start_point, const VectorXd & end_point, int grid_side,
+    double first, double count, std::string path,
+    std::string precision, int num_threads, std::string schedule, int schedule_chunk_size, bool diagnostics
+) {
+    ShardFingerprint fingerprint;
+    fingerprint.add(lambda);
+    return run_shard(RidgeRegression(lambda), fingerprint, X, Y, Xhat, start_point, end_point, grid_side, first, count, path,
+                     precision, num_threads, schedule, schedule_chunk_size, diagnostics);
+}
+
+
+List merge_grid_shards(std::vector<std::string> paths, double min_value, int next_grid_side) {
+    std::vector<GridShard> shards;
+    for (const std::string & path : paths) {
+        shards.push_back(GridShardFile::read(path));
+    }
+    const SingleGridResult merged = merge_shards(shards);
+    List result = List::create(Named("y_grid") = LazyPointMatrix::create(merged.grid),
+                               Named("y_grid_parameters") = to_list(merged.grid),
+                               Named("p_values") = merged.p_values);
+    if (next_grid_side > 0) {
+        // The refinement does not depend on the model
+        List next_grids(merged.p_values.rows());
+        for (Index i = 0; i < merged.p_values.rows(); i++) {
+            next_grids[i] = to_list(MultiGridAlgorithm<LinearRegression>::create_new_grid_from_pvalues(
+                merged.grid, merged.p_values.row(i), min_value, next_grid_side
+            ));
+        }
+        result.push_back(next_grids, "next_y_grid_parameters");
+    }
+    return result;
+}
+
+
+void init_lazy_point_matrix(DllInfo * dll) {
+    LazyPointMatrix::init(dll);
 }
@@ -1,19 +1,41 @@
 /*! @file */
 #ifndef __EXPORTS_HHP
 #define __EXPORTS_HHP
+#include <string>
+#include <RcppEigen.h>
+#include "algorithms/adaptive_grid.hpp"
+#include "algorithms/exact_interval.hpp"
+#include "algorithms/level_sets.hpp"
 #include "algorithms/multi_grid.hpp"
+#include "algorithms/predictor.hpp"
+#include "algorithms/shards.hpp"
 #include "algorithms/single_grid.hpp"
+#include "algorithms/split.hpp"
+#include "low_discrepancy.hpp"
+#include "models/kernel_ridge.hpp"
 #include "models/linear_regr.hpp"
 
+using Rcpp::List;
+
 // Remark: Rcpp does not work if the Eigen namespace is omitted from exported definitions.
+// The algorithms and models do not depend on Rcpp: the functions below only convert their results to R lists.
+// The `run_*` functions evaluate the grid points in parallel with `num_threads` threads (0: the OpenMP default),
+// using the OpenMP `schedule` ("static", "dynamic" or "guided") with `schedule_chunk_size` (0: the OpenMP default),
+// see @ref ParallelOptions. The functions with a `precision` argument compute the scores of the grid points in double precision
+// ("double") or in single precision with a double precision check of the close ones ("mixed"), with the same p-values (see @ref Precision).
+// When `diagnostics` is true, they add to the returned list a `diagnostics` element,
+// with the phase timings and counters of the run (see @ref RunDiagnostics).
+// The training data `X` and `Y` are mapped (they must be double matrices), and passed to the algorithms as
+// a @ref DataView: they are never copied, except by the predictors of @ref new_linear_conformal_predictor, which own a copy that can grow.
 
 // [[Rcpp::export]]
 /*! Run a conformal algorithm with a simple grid and a linear regression model.
     For details, see @ref SingleGridAlgorithm::run.
 */
 List run_linear_conformal_single_grid(
-    const Eigen::MatrixXd & X, const Eigen::MatrixXd & Y, const Eigen::MatrixXd & Xhat,
-    int grid_side = 500, double grid_param = 1.25
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    int grid_side = 500, double grid_param = 1.25,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
 );
 
 // [[Rcpp::export]]
@@ -23,8 +45,9 @@ List run_linear_conformal_single_grid(
     \param lambda lambda parameter for the ridge regression
 */
 List run_ridge_conformal_single_grid(
-    const Eigen::MatrixXd & X, const Eigen::MatrixXd & Y, const Eigen::MatrixXd & Xhat,
-    double lambda, int grid_side = 500, double grid_param = 1.25
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, int grid_side = 500, double grid_param = 1.25,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
 );
 
 
@@ -33,9 +56,10 @@ List run_ridge_conformal_single_grid(
 */
 // [[Rcpp::export]]
 List run_linear_conformal_multi_grid(
-    const Eigen::MatrixXd & X, const Eigen::MatrixXd & Y, const Eigen::MatrixXd & Xhat,
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
     const Eigen::VectorXd & grid_levels, const Eigen::VectorXd & grid_sides, double initial_grid_param,
-    bool print_progress = false
+    bool print_progress = false,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
 );
 
 /*! Run a conformal algorithm with automatic multi grid refinement and ridge regression model.
@@ -45,9 +69,396 @@ List run_linear_conformal_multi_grid(
 */
 // [[Rcpp::export]]
 List run_ridge_conformal_multi_grid(
-    const Eigen::MatrixXd & X, const Eigen::MatrixXd & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    const Eigen::VectorXd & grid_levels, const Eigen::VectorXd & grid_sides, double initial_grid_param,
+    bool print_progress = false,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a kernel ridge regression model, with a Nystroem approximation of the kernel.
+    For details, see @ref SingleGridAlgorithm::run and @ref NystroemKernelRidge.
+
+    \param kernel kernel: "gaussian" (\f$ \exp(-\gamma \|x - z\|^2) \f$) or "polynomial" (\f$ (\gamma x^T z + coef0)^{degree} \f$)
+    \param lambda lambda parameter for the ridge regression on the features
+    \param n_landmarks number of landmarks of the approximation (drawn among the observations with `seed`)
+*/
+// [[Rcpp::export]]
+List run_kernel_conformal_single_grid(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    std::string kernel = "gaussian", double lambda = 1, int n_landmarks = 100,
+    double gamma = 1, int degree = 2, double coef0 = 1, unsigned int seed = 0,
+    int grid_side = 500, double grid_param = 1.25,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with automatic multi grid refinement and a kernel ridge regression model.
+    See @ref MultiGridAlgorithm::run and @ref run_kernel_conformal_single_grid for details.
+*/
+// [[Rcpp::export]]
+List run_kernel_conformal_multi_grid(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
     const Eigen::VectorXd & grid_levels, const Eigen::VectorXd & grid_sides, double initial_grid_param,
-    bool print_progress = false
+    std::string kernel = "gaussian", double lambda = 1, int n_landmarks = 100,
+    double gamma = 1, int degree = 2, double coef0 = 1, unsigned int seed = 0,
+    bool print_progress = false,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm on the points of a low-discrepancy sequence (quasi-Monte Carlo) and a linear regression model.
+    The points cover the same box as the grid of @ref run_linear_conformal_single_grid, but their number does not grow exponentially with d.
+    See @ref SingleGridAlgorithm::run_on_points and @ref LowDiscrepancySet for details.
+
+    \param n_points number of points
+    \param sequence low-discrepancy sequence: "sobol" (up to d = 21) or "halton"
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_qmc(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double n_points = 1e5, std::string sequence = "sobol", double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm on the points of a low-discrepancy sequence (quasi-Monte Carlo) and a ridge regression model.
+    See @ref run_linear_conformal_qmc for details.
+
+    \param lambda lambda parameter for the ridge regression
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_qmc(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, double n_points = 1e5, std::string sequence = "sobol", double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with multi grid refinement on the points of a low-discrepancy sequence and a linear regression model.
+    See @ref MultiGridAlgorithm::run for details.
+
+    \param n_points number of points at each level (must be one item longer than grid_levels)
+    \param sequence low-discrepancy sequence: "sobol" (up to d = 21) or "halton"
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_multi_qmc(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    const Eigen::VectorXd & grid_levels, const Eigen::VectorXd & n_points, double initial_grid_param = 1.25,
+    std::string sequence = "sobol", bool print_progress = false,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with multi grid refinement on the points of a low-discrepancy sequence and a ridge regression model.
+    See @ref run_linear_conformal_multi_qmc for details.
+
+    \param lambda lambda parameter for the ridge regression
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_multi_qmc(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    const Eigen::VectorXd & grid_levels, const Eigen::VectorXd & n_points, double initial_grid_param = 1.25,
+    std::string sequence = "sobol", bool print_progress = false,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run an exact (grid-free) conformal algorithm for a one-dimensional response and linear regression model.
+    See @ref ExactIntervalAlgorithm::run for details.
+
+    \param alpha the returned intervals contain the points with p-value greater or equal than alpha
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_exact(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double alpha = 0.05,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run an exact (grid-free) conformal algorithm for a one-dimensional response and ridge regression model.
+    See @ref ExactIntervalAlgorithm::run for details.
+
+    \param lambda lambda parameter for the ridge regression
+    \param alpha the returned intervals contain the points with p-value greater or equal than alpha
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_exact(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, double alpha = 0.05,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a split conformal algorithm with a simple grid and a linear regression model.
+    See @ref SplitConformalAlgorithm and @ref SingleGridAlgorithm::run for details.
+
+    \param train_fraction fraction of the observations used to fit the model (the others are used for calibration)
+    \param seed seed used to split the observations
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_split(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double train_fraction = 0.5, int grid_side = 500, double grid_param = 1.25, int seed = 0,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a split conformal algorithm with a simple grid and a ridge regression model.
+    See @ref SplitConformalAlgorithm and @ref SingleGridAlgorithm::run for details.
+
+    \param lambda lambda parameter for the ridge regression
+    \param train_fraction fraction of the observations used to fit the model (the others are used for calibration)
+    \param seed seed used to split the observations
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_split(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, double train_fraction = 0.5, int grid_side = 500, double grid_param = 1.25, int seed = 0,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with sparse adaptive grid refinement and linear regression model.
+    See @ref AdaptiveGridAlgorithm::run for details.
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_adaptive_grid(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    const Eigen::VectorXd & grid_levels, int initial_grid_side = 10, double initial_grid_param = 1.25,
+    bool print_progress = false,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with sparse adaptive grid refinement and ridge regression model.
+    See @ref AdaptiveGridAlgorithm::run for details.
+
+    \param lambda lambda parameter for the ridge regression
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_adaptive_grid(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    const Eigen::VectorXd & grid_levels, int initial_grid_side = 10, double initial_grid_param = 1.25,
+    bool print_progress = false,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a linear regression model, returning only the points with p-value >= alpha.
+    See @ref SingleGridAlgorithm::run_sparse for details.
+
+    \param alpha minimum p-value of the returned points
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_sparse(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double alpha = 0.05, int grid_side = 500, double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a ridge regression model, returning only the points with p-value >= alpha.
+    See @ref SingleGridAlgorithm::run_sparse for details.
+
+    \param lambda lambda parameter for the ridge regression
+    \param alpha minimum p-value of the returned points
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_sparse(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, double alpha = 0.05, int grid_side = 500, double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
 );
 
+/*! Run a conformal algorithm with a simple grid and a linear regression model, returning only whether each grid point has p-value >= alpha.
+    See @ref SingleGridAlgorithm::run_membership for details.
+    The result has a `members` element with a raw vector for each `Xhat`, packing a bit for each grid point:
+    `as.logical(rawToBits(members[[i]]))[seq_len(grid_side^d)]` gives the membership of the grid points.
+
+    \param alpha minimum p-value of the points in the conformal region
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_membership(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double alpha = 0.05, int grid_side = 500, double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a ridge regression model, returning only whether each grid point has p-value >= alpha.
+    See @ref run_linear_conformal_membership and @ref SingleGridAlgorithm::run_membership for details.
+
+    \param lambda lambda parameter for the ridge regression
+    \param alpha minimum p-value of the points in the conformal region
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_membership(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, double alpha = 0.05, int grid_side = 500, double grid_param = 1.25,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Compute the coordinates of some points of a grid (see @ref Grid), e.g. from the indices returned by the `*_sparse` functions.
+
+    \param start_point start point of the grid (bottom-left)
+    \param end_point end point of the grid (top-right)
+    \param grid_side number of points for each side of the grid
+    \param indices indices of the points (starting from 1)
+    \return The point coordinates (one row for each index)
+*/
+// [[Rcpp::export]]
+Eigen::MatrixXd get_grid_points(
+    const Eigen::VectorXd & start_point, const Eigen::VectorXd & end_point, int grid_side,
+    const Eigen::VectorXd & indices
+);
+
+/*! Run a conformal algorithm with a simple grid and a linear regression model, evaluating the grid one chunk at a time.
+    See @ref SingleGridAlgorithm::run_chunked for details.
+
+    \param reducer how to reduce the p-values: "threshold" (keep the points with p-value >= alpha),
+        "histogram" (histogram of the p-values with n_bins bins) or "bounding_box" (bounding box of the points with p-value >= alpha)
+    \param alpha threshold for the "threshold" and "bounding_box" reducers
+    \param n_bins number of bins for the "histogram" reducer
+    \param chunk_size number of grid points evaluated at a time
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_chunked(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    std::string reducer = "threshold", double alpha = 0.05, int n_bins = 20,
+    int grid_side = 500, double grid_param = 1.25, double chunk_size = 1e6,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a ridge regression model, evaluating the grid one chunk at a time.
+    See @ref SingleGridAlgorithm::run_chunked and @ref run_linear_conformal_chunked for details.
+
+    \param lambda lambda parameter for the ridge regression
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_chunked(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    std::string reducer = "threshold", double alpha = 0.05, int n_bins = 20,
+    int grid_side = 500, double grid_param = 1.25, double chunk_size = 1e6,
+    int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a linear regression model, returning only the level sets of the p-values.
+    See @ref SingleGridAlgorithm::run and @ref LevelSetExtractor for details.
+    The result has a `level_sets` element with a list for each `Xhat`, holding a list for each alpha with its `alpha`,
+    the `count` of grid points with p-value >= alpha and their extents `start_point` and `end_point` along each axis.
+    For d = 2, these lists also have the `contours` (matrices with a row for each vertex) and whether each one is `closed`;
+    for the other dimensions, the indices of the `boundary_cells` (starting from 1, see @ref get_grid_points for their lower corners).
+    The time spent extracting the level sets is included in the marshalling time of the diagnostics.
+
+    \param alphas levels of the sets
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_level_sets(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    const Eigen::VectorXd & alphas, int grid_side = 500, double grid_param = 1.25,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Run a conformal algorithm with a simple grid and a ridge regression model, returning only the level sets of the p-values.
+    See @ref run_linear_conformal_level_sets and @ref LevelSetExtractor for details.
+
+    \param lambda lambda parameter for the ridge regression
+    \param alphas levels of the sets
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_level_sets(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    double lambda, const Eigen::VectorXd & alphas, int grid_side = 500, double grid_param = 1.25,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Create a conformal predictor with a linear regression model, keeping the training data, their factorisation and the grid,
+    to be queried many times with @ref predict_region and updated with @ref add_observations.
+    See @ref ConformalPredictor for details.
+
+    \return An external pointer to the predictor
+*/
+// [[Rcpp::export]]
+Rcpp::XPtr<ConformalPredictorBase> new_linear_conformal_predictor(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y,
+    int grid_side = 500, double grid_param = 1.25
+);
+
+/*! Create a conformal predictor with a ridge regression model (see @ref new_linear_conformal_predictor).
+
+    \param lambda lambda parameter for the ridge regression
+    \return An external pointer to the predictor
+*/
+// [[Rcpp::export]]
+Rcpp::XPtr<ConformalPredictorBase> new_ridge_conformal_predictor(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, double lambda,
+    int grid_side = 500, double grid_param = 1.25
+);
+
+/*! Compute the p-values of the grid points of a conformal predictor for each `Xhat`.
+    See @ref ConformalPredictorBase::predict_region for details.
+
+    \param predictor external pointer returned by `new_*_conformal_predictor`
+    \return A list with the `y_grid_parameters` and the `p_values` (one row for each `Xhat`)
+*/
+// [[Rcpp::export]]
+List predict_region(
+    Rcpp::XPtr<ConformalPredictorBase> predictor, const Eigen::MatrixXd & Xhat,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0, bool diagnostics = false
+);
+
+/*! Add observations to the training data of a conformal predictor, updating its state incrementally.
+    See @ref ConformalPredictorBase::add_observations for details.
+
+    \param predictor external pointer returned by `new_*_conformal_predictor`
+    \return The number of observations of the updated training data
+*/
+// [[Rcpp::export]]
+int add_observations(
+    Rcpp::XPtr<ConformalPredictorBase> predictor, const Eigen::MatrixXd & X_new, const Eigen::MatrixXd & Y_new
+);
+
+/*! Evaluate a range of consecutive points of a grid with a linear regression model, and write their p-values to a shard file,
+    so that a grid can be split among several worker processes (e.g. forked with `parallel::mclapply`) and merged with
+    @ref merge_grid_shards. See @ref evaluate_grid_shard and @ref GridShardFile for details.
+    The grid of @ref run_linear_conformal_single_grid goes from `-grid_param * apply(abs(Y), 2, max)` to its opposite.
+    The time spent writing the shard file is included in the marshalling time of the diagnostics.
+    The shard records a fingerprint of `X`, `Y`, `Xhat`, the model (a linear regression being a ridge regression with
+    lambda = 0) and the precision, so that shards of different runs are not merged.
+
+    \param start_point start point of the grid (bottom-left)
+    \param end_point end point of the grid (top-right)
+    \param grid_side number of points for each side of the grid
+    \param first index of the first point of the range (starting from 1)
+    \param count number of points of the range
+    \param path path of the shard file (overwritten)
+    \return A list with the `path`, `first` and `count` of the shard
+*/
+// [[Rcpp::export]]
+List run_linear_conformal_shard(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat,
+    const Eigen::VectorXd & start_point, const Eigen::VectorXd & end_point, int grid_side,
+    double first, double count, std::string path,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0,
+    bool diagnostics = false
+);
+
+/*! Evaluate a range of consecutive points of a grid with a ridge regression model, and write their p-values to a shard file.
+    See @ref run_linear_conformal_shard for details.
+
+    \param lambda lambda parameter for the ridge regression
+*/
+// [[Rcpp::export]]
+List run_ridge_conformal_shard(
+    const Eigen::Map<Eigen::MatrixXd> & X, const Eigen::Map<Eigen::MatrixXd> & Y, const Eigen::MatrixXd & Xhat, double lambda,
+    const Eigen::VectorXd & start_point, const Eigen::VectorXd & end_point, int grid_side,
+    double first, double count, std::string path,
+    std::string precision = "double", int num_threads = 0, std::string schedule = "static", int schedule_chunk_size = 0,
+    bool diagnostics = false
+);
+
+/*! Merge the shard files of a grid, written by `run_*_conformal_shard`, into its p-values (see @ref merge_shards).
+    When `next_grid_side` is positive, the result also has the `next_y_grid_parameters` for each `Xhat`: the grid of the
+    next level of a multi-grid refinement, covering the points with p-value >= `min_value` (as @ref MultiGridAlgorithm::run).
+
+    \param paths paths of the shard files (in any order)
+    \param min_value minimum p-value of the points covered by the next grid
+    \param next_grid_side number of points for each side of the next grid (0: no next grid)
+    \return A list with the `y_grid`, the `y_grid_parameters` and the `p_values` (one row for each `Xhat`)
+*/
+// [[Rcpp::export]]
+List merge_grid_shards(std::vector<std::string> paths, double min_value = 0.05, int next_grid_side = 0);
+
+/*! Register the ALTREP class of the `y_grid` matrices (see @ref LazyPointMatrix), when the package is loaded.
+*/
+// [[Rcpp::init]]
+void init_lazy_point_matrix(DllInfo * dll);
+
 #endif
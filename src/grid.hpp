@@ -1,17 +1,61 @@
 /*! @file */
 #ifndef __GRID_HPP
 #define __GRID_HPP
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <vector>
-#include <Rcpp.h>
-#include <RcppEigen.h>
+#include <Eigen/Dense>
+#include "point_set.hpp"
 
 using namespace Eigen;
-using Rcpp::List;
 
 /*! Class holding a (hyper-)rectangular grid, that avoids storing in memory the coordinates of each point.
 */  
-class Grid {
+class Grid : public PointSet {
     public:
+    /*! Iterator over the points of a grid, in index order.
+        The coordinates are updated incrementally, as in an odometer: moving to the next point
+        recomputes only the coordinates that change, without divisions.
+    */
+    class Iterator {
+        public:
+        /*! Construct an iterator pointing to a point of the grid.
+            \param g grid (must outlive the iterator)
+            \param first index of the first point
+        */
+        Iterator(const Grid & g, PointIndex first = 0);
+
+        /*! Check whether the iterator points to a point of the grid (and not past the last one).
+        */
+        bool is_valid() const {
+            return index < grid.size;
+        };
+
+        /*! Get the index of the current point.
+        */
+        PointIndex get_index() const {
+            return index;
+        };
+
+        /*! Get the coordinates of the current point.
+        */
+        const VectorXd & get_point() const {
+            return point;
+        };
+
+        /*! Move to the next point of the grid.
+        */
+        void next();
+
+        private:
+        const Grid & grid;
+        PointIndex index;
+        std::vector<int> coords;
+        VectorXd point;
+    };
+
     /*! Construct a grid object.
         \param s start point (bottom-left)
         \param e end point (top-right)
@@ -23,6 +67,7 @@ class Grid {
         d(s.size())
     {
         compute_step_increment();
+        compute_size();
     };
 
     /*! Get the starting point of the grid (bottom-left).
@@ -55,31 +100,129 @@ class Grid {
     /*! Get the size of the grid.
         \return The number of grid points for this grid
     */  
-    int get_size() const;
+    PointIndex get_size() const override {
+        return size;
+    };
+
+    /*! Get the dimension of the grid.
+    */  
+    int get_dimension() const override {
+        return d;
+    };
+
+    using PointSet::get_point;
 
     /*! Get the i-th point of the grid (0: bottom left, get_size() - 1: top right), where i = point_idx;
         This is not stored, but calcolated on the fly.
-        \return The point coordinates 
+        \param point_idx index of the point
+        \param point output vector (must already have size d)
     */  
-    VectorXd get_point(int point_idx) const;
+    void get_point(PointIndex point_idx, VectorXd & point) const override;
+
+    /*! Get a single coordinate of the i-th point of the grid, in \f$ O(1) \f$.
+        \param point_idx index of the point
+        \param k index of the coordinate
+    */
+    double get_coordinate(PointIndex point_idx, int k) const override;
+
+    /*! Get a range of consecutive points of the grid, writing their coordinates in existing storage.
+        Each coordinate is constant on runs of consecutive points, which are filled in bulk.
+        \param first index of the first point
+        \param points output matrix (one row for each point, d columns)
+    */
+    void get_points(PointIndex first, Ref<MatrixXd> points) const override;
 
     /*! Compute the coordinates for each point of the grid and collect them in a matrix.
         \return The point coordinates 
     */  
     MatrixXd collect() const;
-
-    /*! Get the parameters of the grid as an Rcpp list
-        \return A Rcpp list
-    */
-    List get_parameters_as_list() const;
+    using PointSet::collect;
 
     private:
     void compute_step_increment();
+    void compute_size();
     VectorXd start_point;
     VectorXd end_point;
     VectorXd step_increment;
     int grid_side;
     int d;
+    PointIndex size;
+    //! Distance between the indices of two points that differ by one step in each direction
+    std::vector<PointIndex> strides;
 };
 
+
+inline void Grid::compute_size() {
+    size = 1;
+    strides.resize(d);
+    for (int i = 0; i < d; i++) {
+        strides[i] = size;
+        if (size > std::numeric_limits<PointIndex>::max() / grid_side) {
+            throw std::invalid_argument("The grid is too large (grid_side = " + std::to_string(grid_side) +
+                ", d = " + std::to_string(d) + ")");
+        }
+        size *= grid_side;
+    }
+}
+
+inline void Grid::compute_step_increment() {
+    step_increment = (end_point - start_point) / (grid_side - 1);
+}
+
+inline void Grid::get_point(PointIndex point_idx, VectorXd & point) const {
+    for (int i = 0; i < d; i++) {
+      int point_idx_on_side = point_idx % grid_side;
+      point(i) = point_idx_on_side * step_increment(i) + start_point(i);
+      point_idx /= grid_side;
+    }
+}
+
+inline double Grid::get_coordinate(PointIndex point_idx, int k) const {
+    const int point_idx_on_side = (point_idx / strides[k]) % grid_side;
+    return point_idx_on_side * step_increment(k) + start_point(k);
+}
+
+inline void Grid::get_points(PointIndex first, Ref<MatrixXd> points) const {
+    const PointIndex count = points.rows();
+    for (int i = 0; i < d; i++) {
+        // The i-th coordinate changes every strides[i] points
+        int point_idx_on_side = (first / strides[i]) % grid_side;
+        PointIndex run_length = strides[i] - first % strides[i];
+        for (PointIndex j = 0; j < count; ) {
+            const PointIndex length = std::min(run_length, count - j);
+            points.col(i).segment(j, length).setConstant(point_idx_on_side * step_increment(i) + start_point(i));
+            j += length;
+            run_length = strides[i];
+            point_idx_on_side = point_idx_on_side + 1 < grid_side ? point_idx_on_side + 1 : 0;
+        }
+    }
+}
+
+inline MatrixXd Grid::collect() const {
+    MatrixXd y_grid(size, d);
+    get_points(0, y_grid);
+    return y_grid;
+}
+
+inline Grid::Iterator::Iterator(const Grid & g, PointIndex first) :
+    grid(g), index(first), coords(g.d), point(g.d)
+{
+    for (int i = 0; i < grid.d; i++) {
+        coords[i] = (first / grid.strides[i]) % grid.grid_side;
+        point(i) = coords[i] * grid.step_increment(i) + grid.start_point(i);
+    }
+}
+
+inline void Grid::Iterator::next() {
+    index++;
+    for (int i = 0; i < grid.d; i++) {
+        if (++coords[i] < grid.grid_side) {
+            point(i) = coords[i] * grid.step_increment(i) + grid.start_point(i);
+            return;
+        }
+        coords[i] = 0;
+        point(i) = grid.start_point(i);
+    }
+}
+
 #endif
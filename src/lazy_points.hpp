@@ -0,0 +1,183 @@
+/*! @file */
+#ifndef __LAZY_POINTS_HPP
+#define __LAZY_POINTS_HPP
+#include <algorithm>
+#include <limits>
+#include <RcppEigen.h>
+#include <Rversion.h>
+// Before R 3.6, the ALTREP header is not compatible with C++
+#if R_VERSION < R_Version(3, 6, 0)
+#define class altrep_class
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
+#else
+#include <R_ext/Altrep.h>
+#endif
+#include "point_set.hpp"
+
+/*! R matrix with the coordinates of the points of a @ref PointSet (one row for each point, as `collect()`),
+    implemented as an ALTREP real vector: the coordinates are computed when they are accessed, instead of being stored,
+    so that returning the points of a large grid costs neither time nor memory.
+    Single elements and subsets (e.g. `y_grid[p_values >= alpha, ]`) are computed with `get_coordinate`,
+    ranges (e.g. `colMeans(y_grid)`) with `get_points` in blocks.
+    The matrix is materialised only when R needs a pointer to its data (e.g. for BLAS operations, or when it is modified).
+    This is the only part of the package depending on the R internals, and is only used by exports.cpp.
+*/
+class LazyPointMatrix {
+    public:
+    /*! Register the ALTREP class (when the package is loaded).
+    */
+    static void init(DllInfo * dll) {
+        R_altrep_class_t & altrep_class = get_class();
+        altrep_class = R_make_altreal_class("lazy_point_matrix", "cppconformal", dll);
+        R_set_altrep_Length_method(altrep_class, length);
+        R_set_altrep_Inspect_method(altrep_class, inspect);
+        R_set_altrep_Duplicate_method(altrep_class, duplicate);
+        R_set_altvec_Dataptr_method(altrep_class, dataptr);
+        R_set_altvec_Dataptr_or_null_method(altrep_class, dataptr_or_null);
+        R_set_altvec_Extract_subset_method(altrep_class, extract_subset);
+        R_set_altreal_Elt_method(altrep_class, elt);
+        R_set_altreal_Get_region_method(altrep_class, get_region);
+    };
+
+    /*! Create the matrix of the points of a set.
+        \param points set of points (copied, since it must live as long as the matrix)
+        \return The R matrix (size x d)
+    */
+    template<class Points>
+    static Rcpp::RObject create(const Points & points) {
+        if (points.get_size() > std::numeric_limits<int>::max()) {
+            Rcpp::stop("The set has too many points for an R matrix: use y_grid_parameters instead");
+        }
+        // The copy of the set is released by the garbage collector, with the last matrix referring to it.
+        // The pointer is stored as a PointSet *, the type it is read and deleted with
+        Rcpp::RObject owner = R_MakeExternalPtr(static_cast<PointSet *>(new Points(points)), R_NilValue, R_NilValue);
+        R_RegisterCFinalizerEx(owner, finalize, TRUE);
+        Rcpp::RObject matrix = R_new_altrep(get_class(), owner, R_NilValue);
+        Rcpp::IntegerVector dim = Rcpp::IntegerVector::create(points.get_size(), points.get_dimension());
+        Rf_setAttrib(matrix, R_DimSymbol, dim);
+        return matrix;
+    };
+
+    //! Number of points generated at a time when a range of the matrix is read
+    static const PointIndex region_block_size = 256;
+
+    private:
+    static R_altrep_class_t & get_class() {
+        static R_altrep_class_t altrep_class;
+        return altrep_class;
+    };
+
+    static void finalize(SEXP owner) {
+        delete static_cast<PointSet *>(R_ExternalPtrAddr(owner));
+        R_ClearExternalPtr(owner);
+    };
+
+    static const PointSet & get_points(SEXP x) {
+        return *static_cast<const PointSet *>(R_ExternalPtrAddr(R_altrep_data1(x)));
+    };
+
+    /*! Get the materialised data (data2 of the ALTREP object), or R_NilValue.
+    */
+    static SEXP get_materialized(SEXP x) {
+        return R_altrep_data2(x);
+    };
+
+    static R_xlen_t length(SEXP x) {
+        const PointSet & points = get_points(x);
+        return R_xlen_t(points.get_size()) * points.get_dimension();
+    };
+
+    static Rboolean inspect(SEXP x, int, int, int, void (*)(SEXP, int, int, int)) {
+        const PointSet & points = get_points(x);
+        Rprintf("lazy_point_matrix (%lld x %d, %s)\n", (long long) points.get_size(), points.get_dimension(),
+                get_materialized(x) == R_NilValue ? "computed on access" : "materialised");
+        return TRUE;
+    };
+
+    /*! Duplicate the matrix, sharing the points until one of the copies is materialised.
+    */
+    static SEXP duplicate(SEXP x, Rboolean) {
+        if (get_materialized(x) != R_NilValue) {
+            // The default duplication copies the materialised data
+            return nullptr;
+        }
+        return R_new_altrep(get_class(), R_altrep_data1(x), R_NilValue);
+    };
+
+    static void * dataptr(SEXP x, Rboolean) {
+        if (get_materialized(x) == R_NilValue) {
+            const PointSet & points = get_points(x);
+            SEXP data = PROTECT(Rf_allocVector(REALSXP, length(x)));
+            points.get_points(0, Map<MatrixXd>(REAL(data), points.get_size(), points.get_dimension()));
+            R_set_altrep_data2(x, data);
+            UNPROTECT(1);
+        }
+        return REAL(get_materialized(x));
+    };
+
+    static const void * dataptr_or_null(SEXP x) {
+        return get_materialized(x) == R_NilValue ? nullptr : REAL(get_materialized(x));
+    };
+
+    static double elt(SEXP x, R_xlen_t i) {
+        if (get_materialized(x) != R_NilValue) {
+            return REAL(get_materialized(x))[i];
+        }
+        const PointSet & points = get_points(x);
+        return points.get_coordinate(i % points.get_size(), i / points.get_size());
+    };
+
+    /*! Copy a range of the matrix (in column-major order), generating the points of each column in blocks.
+    */
+    static R_xlen_t get_region(SEXP x, R_xlen_t start, R_xlen_t size, double * buffer) {
+        const R_xlen_t count = std::min(size, length(x) - start);
+        if (get_materialized(x) != R_NilValue) {
+            std::copy(REAL(get_materialized(x)) + start, REAL(get_materialized(x)) + start + count, buffer);
+            return count;
+        }
+        const PointSet & points = get_points(x);
+        const PointIndex n_points = points.get_size();
+        const PointIndex block_size = region_block_size;
+        MatrixXd block(block_size, points.get_dimension());
+        for (R_xlen_t i = 0; i < count; ) {
+            const int k = (start + i) / n_points;
+            const PointIndex first = (start + i) % n_points,
+                             block_count = std::min({block_size, n_points - first, PointIndex(count - i)});
+            points.get_points(first, block.topRows(block_count));
+            std::copy(block.col(k).data(), block.col(k).data() + block_count, buffer + i);
+            i += block_count;
+        }
+        return count;
+    };
+
+    /*! Extract the elements of a vector subset `x[indices]` (1-based indices, as integers or doubles).
+    */
+    static SEXP extract_subset(SEXP x, SEXP indices, SEXP) {
+        if (get_materialized(x) != R_NilValue || (TYPEOF(indices) != INTSXP && TYPEOF(indices) != REALSXP)) {
+            // The default subsetting reads the materialised data, or handles the other index types
+            return nullptr;
+        }
+        const PointSet & points = get_points(x);
+        const R_xlen_t n_indices = XLENGTH(indices), n_elements = length(x);
+        SEXP result = PROTECT(Rf_allocVector(REALSXP, n_indices));
+        double * values = REAL(result);
+        for (R_xlen_t j = 0; j < n_indices; j++) {
+            R_xlen_t i;
+            if (TYPEOF(indices) == INTSXP) {
+                i = INTEGER(indices)[j] == NA_INTEGER ? 0 : INTEGER(indices)[j];
+            } else {
+                const double index = REAL(indices)[j];
+                i = ISNAN(index) || index < 1 || index >= double(n_elements) + 1 ? 0 : R_xlen_t(index);
+            }
+            values[j] = i >= 1 && i <= n_elements ?
+                points.get_coordinate((i - 1) % points.get_size(), (i - 1) / points.get_size()) : NA_REAL;
+        }
+        UNPROTECT(1);
+        return result;
+    };
+};
+
+#endif
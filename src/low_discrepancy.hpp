@@ -0,0 +1,272 @@
+/*! @file */
+#ifndef __LOW_DISCREPANCY_HPP
+#define __LOW_DISCREPANCY_HPP
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "point_set.hpp"
+
+using namespace Eigen;
+
+/*! Sobol sequence in the unit (hyper-)cube, with the direction numbers of Joe and Kuo (2008), for up to
+    @ref SobolSequence::max_dimension dimensions. The points are generated in Gray code order (Antonov and Saleev):
+    the first \f$ 2^m \f$ points are the same as in the standard order, and each point is obtained from the previous one
+    with a single XOR for each dimension.
+*/
+class SobolSequence {
+    public:
+    /*! Get the name of the sequence.
+    */
+    static const char * get_name() {
+        return "sobol";
+    };
+
+    /*! Check that the sequence can generate a set of points.
+        \param d dimension of the points
+        \param size number of points
+    */
+    static void check(int d, PointIndex size) {
+        if (d > max_dimension) {
+            throw std::invalid_argument("The Sobol sequence is available for up to " + std::to_string(max_dimension) +
+                " dimensions (d = " + std::to_string(d) + ")");
+        }
+        if (size > (PointIndex(1) << bits)) {
+            throw std::invalid_argument("The Sobol sequence is available for up to 2^32 points");
+        }
+    };
+
+    /*! Generate consecutive points of the sequence.
+        \param first index of the first point
+        \param points output matrix (one row for each point, d columns)
+    */
+    static void generate(PointIndex first, Ref<MatrixXd> points) {
+        const DirectionNumbers & directions = get_direction_numbers();
+        const int d = points.cols();
+        const double scale = std::ldexp(1.0, -bits);
+
+        // The i-th point is the XOR of the direction numbers corresponding to the bits of the Gray code of i
+        std::array<std::uint32_t, max_dimension> x;
+        x.fill(0);
+        const PointIndex gray_code = first ^ (first >> 1);
+        for (int k = 0; k < bits; k++) {
+            if ((gray_code >> k) & 1) {
+                for (int j = 0; j < d; j++) {
+                    x[j] ^= directions[j][k];
+                }
+            }
+        }
+
+        for (PointIndex i = 0; i < points.rows(); i++) {
+            for (int j = 0; j < d; j++) {
+                points(i, j) = x[j] * scale;
+            }
+            if (i + 1 < points.rows()) {
+                // The Gray code of the next point differs in the lowest zero bit of the index
+                int k = 0;
+                while (((first + i) >> k) & 1) {
+                    k++;
+                }
+                for (int j = 0; j < d; j++) {
+                    x[j] ^= directions[j][k];
+                }
+            }
+        }
+    };
+
+    //! Maximum dimension of the points
+    static const int max_dimension = 21;
+
+    private:
+    //! Number of bits of the direction numbers
+    static const int bits = 32;
+
+    typedef std::array<std::array<std::uint32_t, bits>, max_dimension> DirectionNumbers;
+
+    /*! Get the direction numbers of each dimension (computed on the first call).
+    */
+    static const DirectionNumbers & get_direction_numbers() {
+        static const DirectionNumbers directions = compute_direction_numbers();
+        return directions;
+    };
+
+    static DirectionNumbers compute_direction_numbers() {
+        // Degree s, coefficients a and initial numbers m of the primitive polynomial of each dimension (from the second one)
+        static const int degrees[max_dimension - 1] = {1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 7, 7};
+        static const int coefficients[max_dimension - 1] = {0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14, 1, 13, 16, 19, 22, 25, 1, 4};
+        static const int initial_numbers[max_dimension - 1][7] = {
+            {1}, {1, 3}, {1, 3, 1}, {1, 1, 1}, {1, 1, 3, 3}, {1, 3, 5, 13},
+            {1, 1, 5, 5, 17}, {1, 1, 5, 5, 5}, {1, 1, 7, 11, 19}, {1, 1, 5, 1, 1}, {1, 1, 1, 3, 11}, {1, 3, 5, 5, 31},
+            {1, 3, 3, 9, 7, 49}, {1, 1, 1, 15, 21, 21}, {1, 3, 1, 13, 27, 49}, {1, 1, 1, 15, 7, 5}, {1, 3, 1, 15, 13, 25},
+            {1, 1, 5, 5, 19, 61}, {1, 3, 7, 11, 23, 15, 103}, {1, 3, 7, 13, 13, 15, 69}
+        };
+
+        DirectionNumbers directions;
+        for (int k = 0; k < bits; k++) {
+            directions[0][k] = std::uint32_t(1) << (bits - 1 - k);
+        }
+        for (int j = 1; j < max_dimension; j++) {
+            const int s = degrees[j - 1], a = coefficients[j - 1];
+            std::array<std::uint32_t, bits> & v = directions[j];
+            for (int k = 0; k < s; k++) {
+                v[k] = std::uint32_t(initial_numbers[j - 1][k]) << (bits - 1 - k);
+            }
+            for (int k = s; k < bits; k++) {
+                v[k] = v[k - s] ^ (v[k - s] >> s);
+                for (int l = 1; l < s; l++) {
+                    if ((a >> (s - 1 - l)) & 1) {
+                        v[k] ^= v[k - l];
+                    }
+                }
+            }
+        }
+        return directions;
+    };
+};
+
+/*! Halton sequence in the unit (hyper-)cube: the j-th coordinate of the i-th point is the radical inverse of i
+    in the j-th prime base. It is available in any dimension, but its uniformity degrades faster than the one of
+    the Sobol sequence as the dimension grows.
+*/
+class HaltonSequence {
+    public:
+    /*! Get the name of the sequence.
+    */
+    static const char * get_name() {
+        return "halton";
+    };
+
+    /*! Check that the sequence can generate a set of points (always true).
+    */
+    static void check(int, PointIndex) {};
+
+    /*! Generate consecutive points of the sequence.
+        \param first index of the first point
+        \param points output matrix (one row for each point, d columns)
+    */
+    static void generate(PointIndex first, Ref<MatrixXd> points) {
+        int base = 1;
+        for (int j = 0; j < points.cols(); j++) {
+            base = next_prime(base);
+            const double inverse_base = 1.0 / base;
+            for (PointIndex i = 0; i < points.rows(); i++) {
+                double value = 0, weight = inverse_base;
+                for (PointIndex index = first + i; index > 0; index /= base) {
+                    value += weight * (index % base);
+                    weight *= inverse_base;
+                }
+                points(i, j) = value;
+            }
+        }
+    };
+
+    private:
+    static int next_prime(int n) {
+        for (int candidate = n + 1; ; candidate++) {
+            bool prime = true;
+            for (int divisor = 2; divisor * divisor <= candidate && prime; divisor++) {
+                prime = candidate % divisor != 0;
+            }
+            if (prime) {
+                return candidate;
+            }
+        }
+    };
+};
+
+/*! Class holding the first points of a low-discrepancy sequence in a (hyper-)rectangular box,
+    that avoids storing in memory the coordinates of each point.
+    Unlike a @ref Grid, whose size is exponential in the dimension, the number of points is set freely,
+    so that a region can be estimated in higher dimension with a fixed budget.
+    The points are generated on the fly, and consecutive blocks can be generated in parallel.
+    \param Sequence sequence in the unit cube (@ref SobolSequence or @ref HaltonSequence)
+*/
+template<class Sequence>
+class LowDiscrepancySet : public PointSet {
+    public:
+    /*! Construct a set of points.
+        \param s start point of the box (bottom-left)
+        \param e end point of the box (top-right)
+        \param n number of points
+    */
+    LowDiscrepancySet(const VectorXd & s, const VectorXd & e, PointIndex n) :
+        start_point(s), end_point(e), size(n)
+    {
+        if (size < 1) {
+            throw std::invalid_argument("A low-discrepancy set needs at least one point");
+        }
+        Sequence::check(s.size(), size);
+    };
+
+    /*! Get the name of the sequence.
+    */
+    static const char * get_sequence_name() {
+        return Sequence::get_name();
+    };
+
+    /*! Get the starting point of the box (bottom-left).
+    */
+    const VectorXd & get_start_point() const {
+        return start_point;
+    };
+
+    /*! Get the end point of the box (top-right).
+    */
+    const VectorXd & get_end_point() const {
+        return end_point;
+    };
+
+    /*! Get the typical distance between neighbouring points along each direction,
+        i.e. the step of a grid with the same number of points in the same box.
+    */
+    VectorXd get_step_increment() const {
+        return (end_point - start_point) / std::pow(double(size), 1.0 / get_dimension());
+    };
+
+    PointIndex get_size() const override {
+        return size;
+    };
+
+    int get_dimension() const override {
+        return start_point.size();
+    };
+
+    using PointSet::get_point;
+    void get_point(PointIndex point_idx, VectorXd & point) const override {
+        MatrixXd block(1, get_dimension());
+        get_points(point_idx, block);
+        point = block.row(0).transpose();
+    };
+
+    void get_points(PointIndex first, Ref<MatrixXd> points) const override {
+        Sequence::generate(first, points);
+        points = (points.array().rowwise() * (end_point - start_point).transpose().array()).rowwise()
+                 + start_point.transpose().array();
+    };
+
+    /*! Compute the coordinates of each point of the set and collect them in a matrix.
+        \return The point coordinates
+    */
+    MatrixXd collect() const {
+        MatrixXd points(size, get_dimension());
+        get_points(0, points);
+        return points;
+    };
+    using PointSet::collect;
+
+    private:
+    VectorXd start_point;
+    VectorXd end_point;
+    PointIndex size;
+};
+
+//! Set of points of the Sobol sequence (see @ref LowDiscrepancySet)
+typedef LowDiscrepancySet<SobolSequence> SobolSet;
+
+//! Set of points of the Halton sequence (see @ref LowDiscrepancySet)
+typedef LowDiscrepancySet<HaltonSequence> HaltonSet;
+
+#endif
@@ -0,0 +1,243 @@
+/*! @file */
+#ifndef __KERNEL_RIDGE_HPP
+#define __KERNEL_RIDGE_HPP
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <Eigen/Dense>
+#include "linear_regr.hpp"
+using namespace Eigen;
+
+/*! Gaussian (RBF) kernel \f$ k(x, z) = \exp(-\gamma \|x - z\|^2) \f$.
+*/
+class GaussianKernel {
+    public:
+    /*! Constructs a Gaussian kernel.
+        \param g gamma (must be positive)
+    */
+    GaussianKernel(double g) : gamma(g) {
+        if (gamma <= 0) {
+            throw std::invalid_argument("The gamma of a Gaussian kernel must be positive");
+        }
+    };
+
+    /*! Compute the kernel between each row of A and each row of B.
+        \return The kernel matrix (one row for each row of A, one column for each row of B)
+    */
+    template<typename Derived1, typename Derived2>
+    MatrixXd compute(const MatrixBase<Derived1> & A, const MatrixBase<Derived2> & B) const {
+        MatrixXd squared_distances(A.rows(), B.rows());
+        squared_distances.noalias() = -2 * A * B.transpose();
+        squared_distances.colwise() += A.rowwise().squaredNorm();
+        squared_distances.rowwise() += B.rowwise().squaredNorm().transpose();
+        // The expansion of the distances can be slightly negative because of rounding errors
+        return (-gamma * squared_distances.array().max(0)).exp().matrix();
+    };
+
+    private:
+    double gamma;
+};
+
+/*! Polynomial kernel \f$ k(x, z) = (\gamma x^T z + c_0)^{degree} \f$.
+*/
+class PolynomialKernel {
+    public:
+    /*! Constructs a polynomial kernel.
+        \param deg degree (at least 1)
+        \param g gamma
+        \param c0 coef0
+    */
+    PolynomialKernel(int deg, double g, double c0) : degree(deg), gamma(g), coef0(c0) {
+        if (degree < 1) {
+            throw std::invalid_argument("The degree of a polynomial kernel must be at least 1");
+        }
+    };
+
+    /*! Compute the kernel between each row of A and each row of B.
+        \return The kernel matrix (one row for each row of A, one column for each row of B)
+    */
+    template<typename Derived1, typename Derived2>
+    MatrixXd compute(const MatrixBase<Derived1> & A, const MatrixBase<Derived2> & B) const {
+        MatrixXd kernel(A.rows(), B.rows());
+        kernel.noalias() = gamma * A * B.transpose();
+        return (kernel.array() + coef0).pow(degree).matrix();
+    };
+
+    private:
+    int degree;
+    double gamma;
+    double coef0;
+};
+
+/*! Class holding a kernel ridge regression model, with a rank-m Nyström approximation of the kernel.
+    The m landmarks are drawn among the observations of the first fit, and kept (with the factorisation of their kernel matrix)
+    for the later fits. The observations are mapped to the features \f$ \phi(x) = K_{mm}^{-1/2} k_m(x) \f$,
+    where \f$ k_m(x) \f$ holds the kernel between x and the landmarks, and the model is a ridge regression on the features:
+    a fit costs \f$ O(nm^2) \f$ instead of the \f$ O(n^3) \f$ of exact kernel ridge regression.
+
+    Like @ref LinearRegressionBase, the model supports `fit_base` and `compute_affine_residuals`, so that the residuals of
+    the fit augmented with a point are affine in its covariates: the features of the base data are computed once and
+    shared by the copies of the model, and each `xhat` costs \f$ O(nm) \f$.
+    \param Kernel kernel class (@ref GaussianKernel or @ref PolynomialKernel)
+*/
+template<class Kernel>
+class NystroemKernelRidge {
+    public:
+    /*! Constructs a kernel ridge regression model instance.
+        \param k kernel
+        \param l lambda (penalty of the ridge regression on the features)
+        \param m number of landmarks (the rank of the approximation is at most m)
+        \param s seed used to draw the landmarks
+    */
+    NystroemKernelRidge(const Kernel & k, double l, int m, unsigned int s = 0) :
+        kernel(k), ridge(l), n_landmarks(m), seed(s)
+    {
+        if (n_landmarks < 1) {
+            throw std::invalid_argument("The Nystroem approximation needs at least one landmark");
+        }
+    };
+
+    /*! Fit the kernel ridge regression model
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+    */
+    template<typename Derived1, typename Derived2>
+    void fit(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y) {
+        set_landmarks(X);
+        ridge.fit(compute_features(X), Y);
+    }
+
+    /*! Use a fitted kernel ridge regression model to make a prediction
+        \param Xhat matrix of independent variables
+        \returns prediction of Y corresponding to Xhat
+    */
+    template<typename Derived>
+    MatrixXd predict(const MatrixBase<Derived> & Xhat) {
+        check_landmarks();
+        return ridge.predict(compute_features(Xhat));
+    }
+
+    /*! Use a fitted kernel ridge regression model to make a prediction, writing it in existing storage.
+        \param Xhat matrix of independent variables
+        \param fitted_values output matrix (resized only if its shape is wrong)
+    */
+    template<typename Derived1, typename Derived2>
+    void predict_into(const MatrixBase<Derived1> & Xhat, PlainObjectBase<Derived2> & fitted_values) {
+        check_landmarks();
+        ridge.predict_into(compute_features(Xhat), fitted_values);
+    }
+
+    /*! Compute the features of the base data and factorise their Gram matrix, for later updates
+        (see @ref LinearRegressionBase::fit_update).
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_base(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y) {
+        set_landmarks(X);
+        base_features = std::make_shared<const MatrixXd>(compute_features(X));
+        ridge.fit_base(*base_features, Y);
+    }
+
+    /*! Compute the residuals of the model fitted on X and Y augmented with the point (xhat, y0), as an affine function of y0
+        (see @ref LinearRegressionBase::compute_affine_residuals), with the features of X computed by `fit_base`.
+        \param X matrix of independent variables, that must be the base data of `fit_base` (n x p)
+        \param Y matrix of covariates (n x d)
+        \param xhat values of the independent variables for the added point (1 x p)
+        \param intercept output matrix ((n+1) x d)
+        \param slope output vector (n+1)
+    */
+    template<typename Derived1, typename Derived2, typename Derived3>
+    void compute_affine_residuals(
+        const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, const MatrixBase<Derived3> & xhat,
+        MatrixXd & intercept, VectorXd & slope
+    ) {
+        if (!base_features || base_features->rows() != X.rows()) {
+            throw std::logic_error("Kernel model has not been fitted on the base data yet");
+        }
+        ridge.compute_affine_residuals(*base_features, Y, compute_features(xhat), intercept, slope);
+    }
+
+    /*! Check whether the factorisation of the features of the base data is singular
+        (see @ref LinearRegressionBase::is_base_singular).
+    */
+    bool is_base_singular() const {
+        return ridge.is_base_singular();
+    }
+
+    /*! Get the landmarks (one row for each landmark, empty before the first fit).
+    */
+    const MatrixXd & get_landmarks() const {
+        return landmarks;
+    };
+
+    /*! Get the rank of the approximation, i.e. the number of features (at most the number of landmarks).
+    */
+    int get_rank() const {
+        return feature_map.cols();
+    };
+
+    private:
+    /*! Draw the landmarks among the rows of X and factorise their kernel matrix, if not done by a previous fit.
+        The eigenvalues of the kernel matrix below a relative tolerance are discarded, reducing the rank.
+    */
+    template<typename Derived>
+    void set_landmarks(const MatrixBase<Derived> & X) {
+        if (landmarks.rows() > 0) {
+            return;
+        }
+        const int n = X.rows(), m = std::min(n_landmarks, n);
+        std::vector<int> indices(n);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::default_random_engine generator(seed);
+        for (int i = 0; i < m; i++) {
+            std::uniform_int_distribution<int> uniform(i, n - 1);
+            std::swap(indices[i], indices[uniform(generator)]);
+        }
+        landmarks.resize(m, X.cols());
+        for (int i = 0; i < m; i++) {
+            landmarks.row(i) = X.row(indices[i]);
+        }
+
+        const SelfAdjointEigenSolver<MatrixXd> eigen(kernel.compute(landmarks, landmarks));
+        const VectorXd & eigenvalues = eigen.eigenvalues();
+        const double tolerance = eigenvalues.maxCoeff() * m * NumTraits<double>::epsilon();
+        const int rank = (eigenvalues.array() > tolerance).count();
+        // The eigenvalues are sorted in increasing order
+        feature_map = eigen.eigenvectors().rightCols(rank) * eigenvalues.tail(rank).cwiseSqrt().cwiseInverse().asDiagonal();
+    }
+
+    void check_landmarks() const {
+        if (landmarks.rows() == 0) {
+            throw std::logic_error("Kernel model has not been fitted yet");
+        }
+    }
+
+    /*! Map observations to the features of the approximation.
+        \return The features (one row for each row of X)
+    */
+    template<typename Derived>
+    MatrixXd compute_features(const MatrixBase<Derived> & X) const {
+        return kernel.compute(X, landmarks) * feature_map;
+    }
+
+    Kernel kernel;
+    RidgeRegression ridge;
+    int n_landmarks;
+    unsigned int seed;
+    MatrixXd landmarks;
+    MatrixXd feature_map;
+    // Features of the base data, shared by the copies of the model
+    std::shared_ptr<const MatrixXd> base_features;
+};
+
+//! Kernel ridge regression with a Gaussian kernel (see @ref NystroemKernelRidge)
+typedef NystroemKernelRidge<GaussianKernel> GaussianKernelRidge;
+
+//! Kernel ridge regression with a polynomial kernel (see @ref NystroemKernelRidge)
+typedef NystroemKernelRidge<PolynomialKernel> PolynomialKernelRidge;
+
+#endif
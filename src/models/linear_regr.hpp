@@ -1,11 +1,26 @@
 /*! @file */
 #ifndef __LINEAR_REGR_HPP
 #define __LINEAR_REGR_HPP
-#include <RcppEigen.h>
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Dense>
 using namespace Eigen;
 
 /*! Base class for linear regression models.
     Provides the default copy constructor.
+
+    Models used by the conformal algorithms must provide `fit(X, Y)` and `predict(X)`;
+    `fit` must completely overwrite the previous fit, so that a single instance can be refitted many times.
+    They can also provide `predict_into(X, fitted_values)`, writing the prediction in existing storage.
+    The buffers used by `fit` are kept in the instance and reused when refitting on data with the same shape.
+
+    Linear models also support rank-one updates: `fit_base(X, Y)` factorises the Gram matrix of the training data once,
+    and then `fit_update(xhat, y0)` fits the model on the training data augmented with the single observation (xhat, y0)
+    with the Sherman-Morrison formula, in \f$ O(pd) \f$ (plus \f$ O(p^2) \f$ when xhat changes).
+    New observations can be added to the base data with `add_base_observations(X_new, Y_new)`, without refactorising it.
+    The updates require a non-singular factorisation, see `is_base_singular()`.
+    The base data can also be streamed in blocks of rows, with `begin_base(p, d)`, `add_base_block(X_block, Y_block)`
+    and `end_base()`, so that they never need to be held in a single matrix.
 */
 class LinearRegressionBase {
     public:
@@ -16,20 +31,277 @@ class LinearRegressionBase {
     template<typename Derived>
     MatrixXd predict(const MatrixBase<Derived> & Xhat) {
         if (!is_fitted) {
-            Rcpp::stop("Linear model has not been fitted yet");
+            throw std::logic_error("Linear model has not been fitted yet");
         }
         return Xhat * beta;
     }
 
+    /*! Use a fitted linear regression model to make a prediction, writing it in existing storage.
+        \param Xhat matrix of independent variables
+        \param fitted_values output matrix (resized only if its shape is wrong)
+    */
+    template<typename Derived1, typename Derived2>
+    void predict_into(const MatrixBase<Derived1> & Xhat, PlainObjectBase<Derived2> & fitted_values) {
+        if (!is_fitted) {
+            throw std::logic_error("Linear model has not been fitted yet");
+        }
+        fitted_values.noalias() = Xhat * beta;
+    }
+
+    /*! Fit the model on the training data augmented with the observation (xhat, y0),
+        using the factorisation computed by `fit_base`.
+        \param xhat values of the independent variables for the added observation (1 x p)
+        \param y0 covariates of the added observation (d)
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_update(const MatrixBase<Derived1> & xhat, const MatrixBase<Derived2> & y0) {
+        if (!is_base_fitted) {
+            throw std::logic_error("Linear model has not been fitted on the base data yet");
+        }
+        set_update_xhat(xhat);
+        update_difference = (y0.transpose() - update_base_prediction) / update_denominator;
+        beta = base_beta;
+        beta.noalias() += update_solution * update_difference;
+        is_fitted = true;
+    }
+
+    /*! Compute the residuals of the model fitted on X and Y augmented with the point (xhat, y0),
+        as an affine function of y0: the k-th residual is `intercept.row(k) + slope(k) * y0`.
+        Uses the factorisation computed by `fit_base`, that must have been called on the same X and Y.
+        \param X matrix of independent variables (n x p)
+        \param Y matrix of covariates (n x d)
+        \param xhat values of the independent variables for the added point (1 x p)
+        \param intercept output matrix ((n+1) x d)
+        \param slope output vector (n+1)
+    */
+    template<typename Derived1, typename Derived2, typename Derived3>
+    void compute_affine_residuals(
+        const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, const MatrixBase<Derived3> & xhat,
+        MatrixXd & intercept, VectorXd & slope
+    ) {
+        if (!is_base_fitted) {
+            throw std::logic_error("Linear model has not been fitted on the base data yet");
+        }
+        set_update_xhat(xhat);
+        const int n = X.rows();
+
+        // The augmented fit is beta(y0) = beta + (update_solution / update_denominator) * y0^T
+        beta = base_beta;
+        beta.noalias() -= update_solution * (update_base_prediction / update_denominator);
+        intercept.resize(n + 1, Y.cols());
+        intercept.topRows(n) = Y;
+        intercept.topRows(n).noalias() -= X * beta;
+        intercept.row(n).noalias() = -xhat * beta;
+        slope.resize(n + 1);
+        slope.head(n).noalias() = -X * update_solution / update_denominator;
+        slope(n) = 1 / update_denominator;
+        is_fitted = true;
+    }
+
+    /*! Add observations to the base data factorised by `fit_base`, updating the factorisation:
+        each observation is a rank-one update of the Gram matrix, in \f$ O(p^2) \f$, and a large batch
+        (at least p observations) refactorises the updated Gram matrix, in \f$ O(mp^2 + p^3) \f$.
+        \param X_new matrix of independent variables of the new observations (m x p)
+        \param Y_new matrix of covariates of the new observations (m x d)
+    */
+    template<typename Derived1, typename Derived2>
+    void add_base_observations(const MatrixBase<Derived1> & X_new, const MatrixBase<Derived2> & Y_new) {
+        if (!is_base_fitted) {
+            throw std::logic_error("Linear model has not been fitted on the base data yet");
+        }
+        add_base_block(X_new, Y_new);
+        if (X_new.rows() < X_new.cols()) {
+            for (Index i = 0; i < X_new.rows(); i++) {
+                base_solver.rankUpdate(X_new.row(i).transpose());
+            }
+        } else {
+            base_solver.compute(base_gram);
+        }
+        set_base_beta();
+    }
+
+    /*! Add a block of rows of the base data, when it is streamed (see `begin_base`): the block is only accumulated
+        in the Gram matrix and in the cross product, in \f$ O(mp^2) \f$, and is not needed afterwards.
+        \param X_block matrix of independent variables of the block (m x p)
+        \param Y_block matrix of covariates of the block (m x d)
+    */
+    template<typename Derived1, typename Derived2>
+    void add_base_block(const MatrixBase<Derived1> & X_block, const MatrixBase<Derived2> & Y_block) {
+        base_gram.noalias() += X_block.transpose() * X_block;
+        base_cross_product.noalias() += X_block.transpose() * Y_block;
+    }
+
+    /*! Factorise the base data streamed since `begin_base`, as `fit_base` would on the whole data,
+        so that the model can predict and be updated.
+    */
+    void end_base() {
+        base_solver.compute(base_gram);
+        is_base_fitted = true;
+        set_base_beta();
+    }
+
+    /*! Check whether the factorisation of the base data is singular (e.g. linear regression with p > n, or collinear columns):
+        some of its pivots are zero, up to rounding errors. The rank-one updates of a singular factorisation do not match
+        a refit on the augmented data, so the conformal algorithms refit the model instead (see @ref with_residual_engine).
+    */
+    bool is_base_singular() const {
+        if (!is_base_fitted) {
+            throw std::logic_error("Linear model has not been fitted on the base data yet");
+        }
+        return base_singular;
+    }
+
     protected:
     void set_beta(MatrixXd new_beta) {
         beta = new_beta;
         is_fitted = true;
     }
 
+    /*! Fit a (ridge) regression model, reusing the storage of the previous fit.
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+        \param lambda ridge penalty (0 for linear regression)
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_penalized(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, double lambda) {
+        gram.noalias() = X.transpose() * X;
+        if (lambda != 0) {
+            gram.diagonal().array() += lambda;
+        }
+        cross_product.noalias() = X.transpose() * Y;
+        solver.compute(gram);
+        beta = solver.solve(cross_product);
+        is_fitted = true;
+    }
+
+    /*! Fit a (ridge) regression model on a block of data sets that differ only in the last row of Y, set to each candidate y0,
+        and count the residual norms greater than and equal to the one of the last row (see @ref RefitResidualEngine::compute_p_values).
+        The Gram matrix does not depend on y0, and the cross product of each candidate is the one of the first n rows
+        plus the outer product of the last row of X and y0: the Gram matrix is factorised once for the block,
+        in \f$ O(np^2 + p^3) \f$, then the candidates are processed @ref LinearRegressionBase::batch_tile_size at a time,
+        with a single solve with \f$ d \f$ right-hand sides per candidate and a single matrix product for their predictions,
+        so that the buffers take \f$ O(nd) \f$ memory whatever the size of the block.
+        \param X matrix of independent variables ((n+1) x p)
+        \param Y matrix of covariates ((n+1) x d), whose last row is ignored
+        \param Y0 candidates for the last row of Y (one row for each candidate)
+        \param greater output vector, number of residual norms greater than the one of the last row (for each candidate)
+        \param equal output vector, number of residual norms equal to the one of the last row, itself included (for each candidate)
+        \param lambda ridge penalty (0 for linear regression)
+    */
+    template<typename Derived1, typename Derived2, typename Derived3>
+    void fit_predict_batch_penalized(
+        const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, const MatrixBase<Derived3> & Y0,
+        VectorXi & greater, VectorXi & equal, double lambda
+    ) {
+        const Index n = X.rows() - 1, d = Y.cols();
+        gram.noalias() = X.transpose() * X;
+        if (lambda != 0) {
+            gram.diagonal().array() += lambda;
+        }
+        solver.compute(gram);
+        cross_product.noalias() = X.topRows(n).transpose() * Y.topRows(n);
+
+        greater.resize(Y0.rows());
+        equal.resize(Y0.rows());
+        for (Index first = 0; first < Y0.rows(); first += batch_tile_size) {
+            const Index count = std::min(Index(batch_tile_size), Y0.rows() - first);
+            batch_cross_products.resize(X.cols(), d * count);
+            for (Index j = 0; j < count; j++) {
+                batch_cross_products.middleCols(j * d, d) = cross_product;
+                batch_cross_products.middleCols(j * d, d).noalias() += X.row(n).transpose() * Y0.row(first + j);
+            }
+            batch_beta = solver.solve(batch_cross_products);
+            batch_fitted_values.noalias() = X * batch_beta;
+
+            for (Index j = 0; j < count; j++) {
+                const auto fitted_values = batch_fitted_values.middleCols(j * d, d);
+                batch_residuals = (Y.topRows(n) - fitted_values.topRows(n)).rowwise().norm().array();
+                const double test_residual = (Y0.row(first + j) - fitted_values.row(n)).norm();
+                greater(first + j) = (batch_residuals > test_residual).count();
+                equal(first + j) = (batch_residuals == test_residual).count() + 1;
+            }
+        }
+    }
+
+    //! Number of candidates solved and predicted together by @ref LinearRegressionBase::fit_predict_batch_penalized
+    static const Index batch_tile_size = 16;
+
+    /*! Factorise the (penalized) Gram matrix of the base data, for later rank-one updates.
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+        \param lambda ridge penalty (0 for linear regression)
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_base_penalized(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, double lambda) {
+        base_gram.noalias() = X.transpose() * X;
+        if (lambda != 0) {
+            base_gram.diagonal().array() += lambda;
+        }
+        base_cross_product.noalias() = X.transpose() * Y;
+        base_solver.compute(base_gram);
+        is_base_fitted = true;
+        set_base_beta();
+    }
+
+    /*! Start streaming the base data, clearing the Gram matrix (to the penalty) and the cross product.
+        \param p number of independent variables
+        \param d number of covariates
+        \param lambda ridge penalty (0 for linear regression)
+    */
+    void begin_base_penalized(Index p, Index d, double lambda) {
+        base_gram = MatrixXd::Identity(p, p) * lambda;
+        base_cross_product = MatrixXd::Zero(p, d);
+        is_base_fitted = false;
+    }
+
     private:
+    /*! Solve for the coefficients of the base fit, after (re)factorising the base data.
+    */
+    void set_base_beta() {
+        const VectorXd & pivots = base_solver.vectorD();
+        const double tolerance = pivots.cwiseAbs().maxCoeff() * pivots.size() * NumTraits<double>::epsilon();
+        base_singular = base_solver.info() != Success || (pivots.array().abs() <= tolerance).any();
+        base_beta = base_solver.solve(base_cross_product);
+        beta = base_beta;
+        update_xhat.resize(0);
+        is_fitted = true;
+    }
+
+    /*! Prepare the Sherman-Morrison update for the added observation xhat, if it changed since the last call.
+    */
+    template<typename Derived>
+    void set_update_xhat(const MatrixBase<Derived> & xhat) {
+        if (update_xhat.size() == xhat.size() && update_xhat == xhat.row(0)) {
+            return;
+        }
+        update_xhat = xhat.row(0);
+        update_solution = base_solver.solve(update_xhat.transpose());
+        update_denominator = 1 + update_xhat.dot(update_solution);
+        update_base_prediction.noalias() = update_xhat * base_beta;
+    }
+
     MatrixXd beta;
     bool is_fitted = false;
+    MatrixXd gram;
+    MatrixXd cross_product;
+    LDLT<MatrixXd> solver;
+    MatrixXd batch_cross_products;
+    MatrixXd batch_beta;
+    MatrixXd batch_fitted_values;
+    ArrayXd batch_residuals;
+
+    // Base fit and cached Sherman-Morrison terms for the last added xhat
+    bool is_base_fitted = false;
+    bool base_singular = false;
+    MatrixXd base_gram;
+    MatrixXd base_cross_product;
+    LDLT<MatrixXd> base_solver;
+    MatrixXd base_beta;
+    RowVectorXd update_xhat;
+    VectorXd update_solution;
+    double update_denominator;
+    RowVectorXd update_base_prediction;
+    RowVectorXd update_difference;
 };
 
 /*! Class holding a linear regression model.
@@ -42,7 +314,35 @@ class LinearRegression : public LinearRegressionBase {
     */
     template<typename Derived1, typename Derived2>
     void fit(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & y) {
-        set_beta((X.transpose() * X).ldlt().solve(X.transpose() * y));
+        fit_penalized(X, y, 0);
+    }
+
+    /*! Fit the model on a block of data sets that differ only in the last row of Y, and count the residual norms
+        greater than and equal to the one of the last row (see @ref LinearRegressionBase::fit_predict_batch_penalized).
+    */
+    template<typename Derived1, typename Derived2, typename Derived3>
+    void fit_predict_batch(
+        const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, const MatrixBase<Derived3> & Y0,
+        VectorXi & greater, VectorXi & equal
+    ) {
+        fit_predict_batch_penalized(X, Y, Y0, greater, equal, 0);
+    }
+
+    /*! Factorise the base data for rank-one updates (see @ref LinearRegressionBase::fit_update).
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_base(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y) {
+        fit_base_penalized(X, Y, 0);
+    }
+
+    /*! Start streaming the base data in blocks (see @ref LinearRegressionBase::add_base_block).
+        \param p number of independent variables
+        \param d number of covariates
+    */
+    void begin_base(Index p, Index d) {
+        begin_base_penalized(p, d, 0);
     }
 };
 
@@ -61,9 +361,35 @@ class RidgeRegression : public LinearRegressionBase {
     */
     template<typename Derived1, typename Derived2>
     void fit(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y) {
-        int p = X.cols();
-        auto eye = MatrixXd::Identity(p, p);
-        set_beta((X.transpose() * X + lambda * eye).ldlt().solve(X.transpose() * Y));
+        fit_penalized(X, Y, lambda);
+    }
+
+    /*! Fit the model on a block of data sets that differ only in the last row of Y, and count the residual norms
+        greater than and equal to the one of the last row (see @ref LinearRegressionBase::fit_predict_batch_penalized).
+    */
+    template<typename Derived1, typename Derived2, typename Derived3>
+    void fit_predict_batch(
+        const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y, const MatrixBase<Derived3> & Y0,
+        VectorXi & greater, VectorXi & equal
+    ) {
+        fit_predict_batch_penalized(X, Y, Y0, greater, equal, lambda);
+    }
+
+    /*! Factorise the base data for rank-one updates (see @ref LinearRegressionBase::fit_update).
+        \param X matrix of independent variables
+        \param Y matrix of covariates
+    */
+    template<typename Derived1, typename Derived2>
+    void fit_base(const MatrixBase<Derived1> & X, const MatrixBase<Derived2> & Y) {
+        fit_base_penalized(X, Y, lambda);
+    }
+
+    /*! Start streaming the base data in blocks (see @ref LinearRegressionBase::add_base_block).
+        \param p number of independent variables
+        \param d number of covariates
+    */
+    void begin_base(Index p, Index d) {
+        begin_base_penalized(p, d, lambda);
     }
 
     private:
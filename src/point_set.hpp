@@ -0,0 +1,217 @@
+/*! @file */
+#ifndef __POINT_SET_HPP
+#define __POINT_SET_HPP
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+//! Index of a point in a set (64 bits, since grids can easily have more than 2^31 points)
+typedef std::int64_t PointIndex;
+
+/*! Abstract class for a set of points in the space of the covariates, where the conformal p-values are computed.
+    Implementations can generate the coordinates on the fly instead of storing them.
+*/
+class PointSet {
+    public:
+    virtual ~PointSet() {};
+
+    /*! Get the number of points in the set.
+    */
+    virtual PointIndex get_size() const = 0;
+
+    /*! Get the dimension of the space containing the points.
+    */
+    virtual int get_dimension() const = 0;
+
+    /*! Get the i-th point of the set, writing its coordinates in existing storage.
+        \param point_idx index of the point
+        \param point output vector (must already have size d)
+    */
+    virtual void get_point(PointIndex point_idx, VectorXd & point) const = 0;
+
+    /*! Get a single coordinate of the i-th point of the set.
+        Implementations should override it when a coordinate can be computed without the others.
+        \param point_idx index of the point
+        \param k index of the coordinate
+    */
+    virtual double get_coordinate(PointIndex point_idx, int k) const {
+        return get_point(point_idx)(k);
+    };
+
+    /*! Get a range of consecutive points of the set, writing their coordinates in existing storage.
+        Implementations should override it when the points of a block can be generated faster than one at a time.
+        \param first index of the first point
+        \param points output matrix (one row for each point, d columns): its number of rows is the number of points
+    */
+    virtual void get_points(PointIndex first, Ref<MatrixXd> points) const {
+        VectorXd point(get_dimension());
+        for (PointIndex i = 0; i < points.rows(); i++) {
+            get_point(first + i, point);
+            points.row(i) = point.transpose();
+        }
+    };
+
+    /*! Get the i-th point of the set.
+        \return The point coordinates
+    */
+    VectorXd get_point(PointIndex point_idx) const {
+        VectorXd point(get_dimension());
+        get_point(point_idx, point);
+        return point;
+    };
+
+    /*! Collect the coordinates of some points of the set in a matrix.
+        \param point_indices indices of the points
+        \return The point coordinates (one row for each index)
+    */
+    MatrixXd collect(const std::vector<PointIndex> & point_indices) const {
+        MatrixXd points(point_indices.size(), get_dimension());
+        VectorXd point(get_dimension());
+        for (size_t i = 0; i < point_indices.size(); i++) {
+            get_point(point_indices[i], point);
+            points.row(i) = point;
+        }
+        return points;
+    };
+};
+
+/*! Class holding an explicit list of points (one for each row of a matrix).
+*/
+class PointList : public PointSet {
+    public:
+    /*! Construct a point list.
+        \param p matrix with the coordinates of a point in each row
+    */
+    PointList(const MatrixXd & p) : points(p) {};
+
+    PointIndex get_size() const override {
+        return points.rows();
+    };
+
+    int get_dimension() const override {
+        return points.cols();
+    };
+
+    using PointSet::get_point;
+    void get_point(PointIndex point_idx, VectorXd & point) const override {
+        point = points.row(point_idx);
+    };
+
+    double get_coordinate(PointIndex point_idx, int k) const override {
+        return points(point_idx, k);
+    };
+
+    void get_points(PointIndex first, Ref<MatrixXd> block) const override {
+        block = points.middleRows(first, block.rows());
+    };
+
+    private:
+    MatrixXd points;
+};
+
+/*! Class holding a view on a contiguous range of points of another set, e.g. to evaluate a large grid in chunks.
+    The viewed set must outlive the view.
+*/
+class PointRange : public PointSet {
+    public:
+    /*! Construct a view on a range of points.
+        \param s viewed set of points
+        \param f index of the first point of the range
+        \param c number of points in the range
+    */
+    PointRange(const PointSet & s, PointIndex f, PointIndex c) : points(s), first(f), count(c) {};
+
+    PointIndex get_size() const override {
+        return count;
+    };
+
+    int get_dimension() const override {
+        return points.get_dimension();
+    };
+
+    using PointSet::get_point;
+    void get_point(PointIndex point_idx, VectorXd & point) const override {
+        points.get_point(first + point_idx, point);
+    };
+
+    double get_coordinate(PointIndex point_idx, int k) const override {
+        return points.get_coordinate(first + point_idx, k);
+    };
+
+    void get_points(PointIndex range_first, Ref<MatrixXd> block) const override {
+        points.get_points(first + range_first, block);
+    };
+
+    private:
+    const PointSet & points;
+    PointIndex first;
+    PointIndex count;
+};
+
+/*! Subset of the points of a set (e.g. the points inside a conformal region), stored as a bitset over their indices.
+    The bits are packed in 64-bit words, starting from the least significant bit:
+    threads can modify the set concurrently as long as they modify different words.
+*/
+class PointBitset {
+    public:
+    /*! Construct an empty subset.
+        \param size number of points of the set
+    */
+    PointBitset(PointIndex _size = 0) : size(_size), words((_size + word_bits - 1) / word_bits, 0) {};
+
+    /*! Get the number of points of the set.
+    */
+    PointIndex get_size() const {
+        return size;
+    };
+
+    /*! Check whether the i-th point belongs to the subset.
+    */
+    bool test(PointIndex point_idx) const {
+        return (words[point_idx / word_bits] >> (point_idx % word_bits)) & 1;
+    };
+
+    /*! Add the i-th point to the subset.
+    */
+    void set(PointIndex point_idx) {
+        words[point_idx / word_bits] |= std::uint64_t(1) << (point_idx % word_bits);
+    };
+
+    /*! Add a range of consecutive points to the subset.
+        \param first index of the first point
+        \param count number of points
+    */
+    void set_range(PointIndex first, PointIndex count) {
+        for (PointIndex i = first; i < first + count; i++) {
+            set(i);
+        }
+    };
+
+    /*! Get the number of points in the subset.
+    */
+    PointIndex count() const {
+        PointIndex result = 0;
+        for (std::uint64_t word : words) {
+            result += std::bitset<word_bits>(word).count();
+        }
+        return result;
+    };
+
+    /*! Get the words of the bitset (the i-th point is the bit i % 64 of the word i / 64).
+    */
+    const std::vector<std::uint64_t> & get_words() const {
+        return words;
+    };
+
+    //! Number of points stored in each word
+    static const int word_bits = 64;
+
+    private:
+    PointIndex size;
+    std::vector<std::uint64_t> words;
+};
+
+#endif